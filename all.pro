@@ -0,0 +1,9 @@
+# Библиотека вместе с тестами и замерами
+TEMPLATE = subdirs
+
+SUBDIRS = \
+    lib \
+    tests \
+    bench
+
+lib.file = matrix.pro
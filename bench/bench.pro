@@ -0,0 +1,12 @@
+# Замеры производительности
+TEMPLATE = app
+TARGET = matrix_bench
+
+OBJECTS_DIR = obj
+CONFIG += console c++11 release
+CONFIG -= qt app_bundle
+
+include(../matrix.pri)
+
+SOURCES += \
+    multiply.cpp
@@ -0,0 +1,70 @@
+/*!
+ * \file
+ * \brief Замер быстрого умножения: время классического и
+ * Штрассена--Винограда, ускорение и расхождение результатов
+ *
+ * Запуск: matrix_bench [n [cutoff [maxDepth]]]
+ */
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <chrono>
+
+/*!
+ * \brief Время выполнения умножения, с
+ */
+static double _time(
+    const Matrix &a,
+    const Matrix &b,
+    bool fast,
+    Matrix::TI cutoff,
+    Matrix::TI maxDepth,
+    Matrix **result)
+{
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  *result = Matrix::multiply(a, b, fast, cutoff, maxDepth);
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(
+    int argc,
+    char **argv)
+{
+  const Matrix::TI
+      n = (argc > 1) ? (Matrix::TI) atoi(argv[1]) : 2048,
+      cutoff = (argc > 2) ? (Matrix::TI) atoi(argv[2]) : 512,
+      maxDepth = (argc > 3) ? (Matrix::TI) atoi(argv[3]) : 4;
+
+  for(int mode = 0; mode < 2; ++mode)
+    {
+      Matrix a(n, n, true, 0), b(n, n, mode == 0, 0);
+      for(Matrix::TI i = 0; i < n; ++i)
+        for(Matrix::TI j = 0; j < n; ++j)
+          {
+            a.o(i, j) = rand() / (real64) RAND_MAX - 0.5;
+            b.o(i, j) = rand() / (real64) RAND_MAX - 0.5;
+          }
+
+      Matrix *classic = NULL, *fast = NULL;
+      const double classicTime = _time(a, b, false, cutoff, maxDepth, &classic);
+      const double fastTime = _time(a, b, true, cutoff, maxDepth, &fast);
+
+      real64 distance = 0;
+      for(Matrix::TI i = 0; i < n; ++i)
+        for(Matrix::TI j = 0; j < n; ++j)
+          distance = fmax(distance, fabs(classic->o(i, j) - fast->o(i, j)));
+
+      printf("n = %u, B %s: classical %.3f s, fast %.3f s, speedup %.2f, max diff %.2e\n",
+             n, (mode == 0) ? "rows" : "cols",
+             classicTime, fastTime, classicTime / fastTime, distance);
+
+      delete classic;
+      delete fast;
+    }
+
+  return 0;
+}
@@ -2,8 +2,11 @@
 
 #include "defines.h"
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits>
+
 // TODO Коды ошибки для методов (в виде параметра--ссылки)
-// TODO Ввести методы получения отдельных строк/столбцов (нескольких подряд)
 // TODO Свести в одну _defaultValue и _NaN [в _defaultValue]
 
 /*!
@@ -18,13 +21,95 @@ public:
   typedef real64 TT; // Данные
   typedef uint32 TI; // Итераторы
 
-  static TI indexerRow(TI row, TI col, TI, TI colCount) {return row * colCount + col;}
-  static TI indexerCol(TI row, TI col, TI rowCount, TI) {return col * rowCount + row;}
+  /// Размещение данных по узлам NUMA
+  enum NumaPolicy
+  {
+    NumaDefault,    ///< Политика системы (узел первого касания)
+    NumaInterleave, ///< Страницы чередуются по всем узлам
+    NumaBands       ///< Полосы строк (столбцов) закреплены за узлами
+  };
+
+  /// Полоса данных, закреплённая за узлом NUMA
+  struct NumaBand
+  {
+    TI begin; ///< Первая строка (столбец при хранении столбцами)
+    TI count; ///< Число строк (столбцов)
+    int node; ///< Номер узла или -1, если узел не закреплён
+  };
+
+  /*!
+   * \brief Непрерывный блок строк или столбцов
+   *
+   * Если блок в памяти матрицы непрерывен, Span ссылается на данные матрицы
+   * без копирования и действителен до её следующего изменения размера.
+   * Иначе Span владеет собранной копией.
+   */
+  class Span
+  {
+  public:
+    Span() : _data(NULL), _count(0), _owned(false) {}
+    Span(
+        const TT *data,
+        size_t count,
+        bool owned) : _data(data), _count(count), _owned(owned) {}
+    Span(
+        Span &&other) : _data(other._data), _count(other._count), _owned(other._owned)
+    {other._data = NULL; other._count = 0; other._owned = false;}
+    ~Span() {if(_owned) free((void *) _data);}
+
+    Span(
+        const Span &) = delete;
+    Span &operator=(
+        const Span &) = delete;
+    Span &operator=(
+        Span &&other)
+    {
+      if(this == &other) return *this;
+      if(_owned) free((void *) _data);
+      _data = other._data; _count = other._count; _owned = other._owned;
+      other._data = NULL; other._count = 0; other._owned = false;
+      return *this;
+    }
+
+    const TT *data() const {return _data;}          ///< Данные
+    size_t count() const {return _count;}           ///< Число элементов
+    bool isCopy() const {return _owned;}            ///< Является ли копией
+    bool isEmpty() const {return _count == 0;}      ///< Является ли пустым
+    const TT &operator[](
+        size_t index) const {return _data[index];}  ///< Элемент
+
+  private:
+    const TT *_data;
+    size_t _count;
+    bool _owned;
+  };
+
+  /// Сжатие при сохранении
+  enum Codec
+  {
+    CodecRaw,   ///< Без сжатия
+    CodecLZ4,   ///< Перестановка байтов + LZ4 (если собрано с MATRIX_LZ4)
+    CodecZstd   ///< Перестановка байтов + zstd (если собрано с MATRIX_ZSTD)
+  };
+
+  /// Отслеживание изменённых областей
+  enum DirtyMode
+  {
+    DirtyOff,   ///< Не отслеживать
+    DirtyRows,  ///< По полосам строк
+    DirtyCols,  ///< По полосам столбцов
+    DirtyTiles  ///< По прямоугольным блокам
+  };
+
+  static size_t indexerRow(TI row, TI col, TI, TI colCount) {return (size_t) row * colCount + col;}
+  static size_t indexerCol(TI row, TI col, TI rowCount, TI) {return (size_t) col * rowCount + row;}
 
   Matrix(
       TI rowCount,
       TI colCount,
-      bool storeRows = true);
+      bool storeRows = true,
+      TT defaultValue = std::numeric_limits<TT>::quiet_NaN(),
+      bool lazy = false);
   Matrix(
       bool storeRows = true) : Matrix(0, 0, storeRows) {} // NOTE C++11
   Matrix(
@@ -47,19 +132,56 @@ public:
       TI row,
       TI col) const;
 
+  Span row(
+      TI row) const {return rows(row, 1);}  ///< Строка
+  Span col(
+      TI col) const {return cols(col, 1);}  ///< Столбец
+  Span rows(
+      TI row,
+      TI count) const;
+  Span cols(
+      TI col,
+      TI count) const;
+
+  void setRow(
+      TI row,
+      const TT *values);
+  void setCol(
+      TI col,
+      const TT *values);
+
   //----------
   // Параметры
   //----------
 
-  TI size() const {return _size;}                 ///< Объём выделенной памяти
+  size_t size() const {return _size;}             ///< Объём выделенной памяти
   TI rowCount() const {return _rowCount;}         ///< Количество строк
   TI colCount() const {return _colCount;}         ///< Количество столбцов
   bool storeMode() const {return _storeRows;}     ///< Способ внутреннего хранения
+  TT defaultValue() const {return _defaultValue;} ///< Значение по умолчанию
+  bool isLazy() const {return _lazy;}             ///< Признак ленивого выделения
 
   void setStoreMode(
       bool storeRows);
   void setDefaultValue(
       TT defaultValue) {_defaultValue = defaultValue;}
+  void setLazy(
+      bool lazy) {_lazy = lazy;}
+  void fill(
+      TT value);
+
+  //-----
+  // NUMA
+  //-----
+
+  NumaPolicy numaPolicy() const {return _numaPolicy;} ///< Размещение по узлам NUMA
+  void setNumaPolicy(
+      NumaPolicy policy);
+  TI numaBandCount() const;
+  NumaBand numaBand(
+      TI index) const;
+
+  static int numaNodeCount();
 
   void clear();
   bool isEmpty() const {return _size == 0;} ///< Является ли матрица пустой
@@ -77,6 +199,14 @@ public:
   void resize(
       TI rowCount,
       TI colCount);
+  void insertRows(
+      TI row,
+      TI count = 1,
+      const TT *values = NULL);
+  void insertCols(
+      TI col,
+      TI count = 1,
+      const TT *values = NULL);
   void deleteRow(
       TI row,
       TI count = 1);
@@ -106,6 +236,69 @@ public:
       TI colCount,
       bool storeRows = true);
 
+  //---------------------------------
+  // Изменённые области и свёртки
+  //---------------------------------
+
+  DirtyMode dirtyMode() const {return _dirtyMode;} ///< Отслеживание изменений
+  void setDirtyTracking(
+      DirtyMode mode,
+      TI tileRows = 64,
+      TI tileCols = 64);
+  uint64 checkpoint() {return _epoch++;} ///< Отметка для isDirty()
+  bool isDirty(
+      TI row,
+      TI col,
+      uint64 since) const;
+
+  const TT *rowSums() {return _reduce(ReduceRowSum);}   ///< Суммы строк
+  const TT *rowNorms() {return _reduce(ReduceRowNorm);} ///< Евклидовы нормы строк
+  const TT *colSums() {return _reduce(ReduceColSum);}   ///< Суммы столбцов
+  const TT *colNorms() {return _reduce(ReduceColNorm);} ///< Евклидовы нормы столбцов
+
+  //---------------
+  // Упорядочивание
+  //---------------
+
+  void sort(
+      bool alongRows = true,
+      bool descending = false);
+  TI *argsort(
+      bool alongRows = true,
+      bool descending = false) const;
+  TI *topK(
+      TI k,
+      bool alongRows = true,
+      bool descending = true) const;
+  void sortRowsBy(
+      TI col,
+      bool descending = false);
+  void sortColsBy(
+      TI row,
+      bool descending = false);
+
+  //-----------
+  // Арифметика
+  //-----------
+
+  static Matrix *multiply(
+      const Matrix &a,
+      const Matrix &b,
+      bool fast = false,
+      TI cutoff = 512,
+      TI maxDepth = 4);
+
+  //-----------
+  // Сохранение
+  //-----------
+
+  bool save(
+      const char *path,
+      Codec codec = CodecRaw) const;
+
+  static Matrix *load(
+      const char *path);
+
   //--------
   // Отладка
   //--------
@@ -123,21 +316,124 @@ public:
 
 private:
 
-  typedef TI (*MatrixIndexer) (TI row, TI col, TI rowCount, TI colCount);
+  typedef size_t (*MatrixIndexer) (TI row, TI col, TI rowCount, TI colCount);
+
+  /// Кэшируемые свёртки
+  enum Reduction
+  {
+    ReduceRowSum,
+    ReduceRowNorm,
+    ReduceColSum,
+    ReduceColNorm,
+    ReduceCount
+  };
+
+  /// Кэш свёртки: частичные результаты по блокам и итог
+  struct ReductionCache
+  {
+    TT *partial;  // Частичные результаты (по блоку на каждую полосу)
+    TT *result;   // Итог
+    uint64 seen;  // Эпоха последнего обновления (0 -- кэш недействителен)
+    size_t logged;  // Сколько записей журнала изменений уже учтено
+  };
 
   TI
   _rowCount,  // Число строк
-  _colCount,  // Число столбцов
+  _colCount;  // Число столбцов
+  size_t
   _size;      // Объём памяти данных
 
   TT
   *_data,         // Данные
-  _defaultValue,  // Значение по умолчанию для memset
+  _defaultValue,  // Значение по умолчанию для новых элементов
   _NaN;           // NaN
 
   bool _storeRows;         // Признак построчного внутреннего хранения
+  bool _lazy;              // Признак ленивого выделения (нулевые страницы)
+  NumaPolicy _numaPolicy;  // Размещение по узлам NUMA
+  bool _numaPlaced;        // Удалось ли применить размещение
+  bool _mapped;            // Данные выделяются mmap (политика NUMA задавалась)
+
+  DirtyMode _dirtyMode;    // Отслеживание изменений
+  TI
+  _tileRows,  // Заданная высота блока (DirtyTiles)
+  _tileCols,  // Заданная ширина блока (DirtyTiles)
+  _tileH,     // Фактическая высота блока
+  _tileW,     // Фактическая ширина блока
+  _gridRows,  // Число блоков по вертикали
+  _gridCols;  // Число блоков по горизонтали
+  uint64
+  *_stamps,   // Эпоха последней записи в каждый блок
+  _epoch;     // Текущая эпоха
+  size_t
+  *_log,         // Журнал изменённых блоков (номера в порядке изменения)
+  _logCount,     // Число записей в журнале
+  _logCapacity;  // Выделено записей
+  ReductionCache _caches[ReduceCount];
   MatrixIndexer _indexer;  // Индексатор
 
   void _copy(
       const Matrix &copy);
+
+  void _touch(
+      TI row,
+      TI col) {_mark((size_t) (row / _tileH) * _gridCols + col / _tileW);}
+  void _mark(
+      size_t block) {if(_stamps[block] != _epoch) {_stamps[block] = _epoch; _append(block);}}
+  void _append(
+      size_t block);
+  void _touchRange(
+      TI rowBeg,
+      TI rowEnd,
+      TI colBeg,
+      TI colEnd);
+  void _retrack();
+  void _untrack();
+  const TT *_reduce(
+      Reduction kind);
+  void _permute(
+      const TI *order,
+      bool rows);
+  TT *_allocate(
+      TI rowCount,
+      TI colCount);
+  TT *_acquire(
+      size_t size,
+      bool zero) const;
+  TT *_reacquire(
+      TT *data,
+      size_t oldSize,
+      size_t size) const;
+  void _release(
+      TT *data,
+      size_t size) const;
+  void _place(
+      TT *data,
+      TI rowCount,
+      TI colCount);
+
+  Span _span(
+      TI begin,
+      TI count,
+      bool byRows) const;
+  void _scatter(
+      TI index,
+      const TT *values,
+      bool byRows);
+  void _insert(
+      TI pos,
+      TI count,
+      const TT *values,
+      bool byRows);
+
+  static TI _bandCount(
+      TI major);
+  static void _fill(
+      TT *data,
+      size_t count,
+      TT value);
+  static void _copyData(
+      TT *target,
+      const TT *source,
+      size_t count);
 };
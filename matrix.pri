@@ -0,0 +1,42 @@
+# Исходники и параметры сборки библиотеки (общие для самой библиотеки,
+# тестов и замеров)
+
+INCLUDEPATH += \
+    $$PWD/headers
+
+HEADERS += \
+    $$PWD/headers/matrix.h \
+    $$PWD/headers/defines.h
+
+SOURCES += \
+    $$PWD/sources/matrix.cpp \
+    $$PWD/sources/matrixio.cpp \
+    $$PWD/sources/matrixtrack.cpp \
+    $$PWD/sources/matrixsort.cpp \
+    $$PWD/sources/matrixmul.cpp
+
+# Распараллеливание (OpenMP). Без него #pragma omp игнорируются. OpenMP 2.0
+# в MSVC не поддерживает задачи: быстрое умножение тогда параллельно только
+# по данным
+win32-msvc* {
+  QMAKE_CXXFLAGS += -openmp
+} else {
+  QMAKE_CXXFLAGS += -fopenmp
+  QMAKE_LFLAGS += -fopenmp
+}
+
+# Размещение по узлам NUMA (libnuma), если библиотека доступна
+unix:exists(/usr/include/numa.h) {
+  DEFINES += MATRIX_NUMA
+  LIBS += -lnuma
+}
+
+# Сжатие при сохранении (LZ4, zstd), если библиотеки доступны
+unix:exists(/usr/include/lz4.h) {
+  DEFINES += MATRIX_LZ4
+  LIBS += -llz4
+}
+unix:exists(/usr/include/zstd.h) {
+  DEFINES += MATRIX_ZSTD
+  LIBS += -lzstd
+}
@@ -6,15 +6,7 @@ MOC_DIR = moc
 CONFIG += staticlib c++11
 DESTDIR = ../libs
 
-INCLUDEPATH += \
-    headers
-
-HEADERS += \
-    headers/matrix.h \
-    headers/defines.h
-
-SOURCES += \
-    sources/matrix.cpp
+include(matrix.pri)
 
 # Определение разрядности
 ARCH_STR = _x86
@@ -5,11 +5,75 @@
 #include <cmath>
 #include <assert.h>
 
+#ifdef MATRIX_NUMA
+#include <numa.h>
+#include <numaif.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 // DEBUG
 #include <iostream>
 #include <iomanip>
 using namespace std;
 
+// Минимальное число элементов, начиная с которого заполнение распараллеливается
+#define MATRIX_PARALLEL_MIN (1 << 16)
+
+#ifdef MATRIX_NUMA
+/*!
+ * \brief Узлы NUMA, доступные процессу
+ *
+ * Номера узлов могут идти не подряд; узлы без памяти пропускаются.
+ * \param nodes Массив для номеров узлов или NULL
+ * \return Число доступных узлов
+ */
+static int _numaNodes(
+    int *nodes)
+{
+  if(numa_available() < 0) return 0;
+
+  struct bitmask *allowed = numa_get_mems_allowed();
+  if(!allowed) return 0;
+
+  int count = 0;
+  for(int node = 0; node <= numa_max_node(); ++node)
+    if(numa_bitmask_isbitset(allowed, node) && (numa_node_size64(node, NULL) > 0))
+      {
+        if(nodes) nodes[count] = node;
+        ++count;
+      }
+
+  numa_bitmask_free(allowed);
+  return count;
+}
+
+/*!
+ * \brief Применить политику NUMA к диапазону памяти
+ *
+ * Обе границы диапазона [begin, end) округляются вверх до страницы, поэтому
+ * смежные диапазоны не пересекаются и не оставляют страниц между собой:
+ * страница на стыке относится к первому из них. Память должна быть выделена
+ * mmap -- только тогда хвост последней страницы принадлежит ей же.
+ * Уже затронутые страницы переносятся (MPOL_MF_MOVE).
+ * \return Признак успеха (пустой диапазон -- успех)
+ */
+static bool _bind(
+    uintptr_t begin,
+    uintptr_t end,
+    int mode,
+    unsigned long *mask,
+    size_t maxNode)
+{
+  const uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+  begin = (begin + page - 1) & ~(page - 1);
+  end = (end + page - 1) & ~(page - 1);
+  if(end <= begin) return true;
+
+  return mbind((void *) begin, end - begin, mode, mask, maxNode + 1, MPOL_MF_MOVE) == 0;
+}
+#endif
+
 /*!
  * \brief Конструктор
  *
@@ -18,16 +82,39 @@ using namespace std;
  * \param colCount Число столбцов
  * \param storeRows Признак построчного внутреннего хранения.
  * При построчном хранении данные строк следуют в памяти друг за другом.
+ * \param defaultValue Значение, которым заполняются новые элементы
+ * \param lazy Признак ленивого выделения. При нулевом defaultValue память
+ * берётся у системы уже обнулённой и страницы не затрагиваются до первой записи.
  */
 Matrix::Matrix(
     TI rowCount,
     TI colCount,
-    bool storeRows) :
+    bool storeRows,
+    TT defaultValue,
+    bool lazy) :
   _data(NULL),
-  _defaultValue(-1), // Провоцирует NaN
+  _defaultValue(defaultValue),
   _NaN(NAN),
-  _storeRows(storeRows)
+  _storeRows(storeRows),
+  _lazy(lazy),
+  _numaPolicy(NumaDefault),
+  _numaPlaced(false),
+  _mapped(false),
+  _dirtyMode(DirtyOff),
+  _tileRows(64),
+  _tileCols(64),
+  _tileH(1),
+  _tileW(1),
+  _gridRows(0),
+  _gridCols(0),
+  _stamps(NULL),
+  _epoch(1),
+  _log(NULL),
+  _logCount(0),
+  _logCapacity(0)
 {
+  memset(_caches, 0, sizeof(_caches));
+
   _indexer = storeRows ?
         (MatrixIndexer) indexerRow
       :
@@ -40,11 +127,8 @@ Matrix::Matrix(
     {
       _rowCount = rowCount;
       _colCount = colCount;
-      _size = _colCount * _rowCount * sizeof(TT);
-      _data = (TT *) malloc(_size);
-
-      assert(_data);
-      memset(_data, _defaultValue, _size);
+      _size = (size_t) _colCount * _rowCount * sizeof(TT);
+      _data = _allocate(_rowCount, _colCount);
     }
 }
 
@@ -54,12 +138,391 @@ void Matrix::_copy(
   _rowCount = copy._rowCount;
   _colCount = copy._colCount;
   _size = copy._size;
-  _data = (TT *) malloc(_size);
+  _data = NULL;
+  _defaultValue = copy._defaultValue;
+  _NaN = NAN;
   _storeRows = copy._storeRows;
+  _lazy = copy._lazy;
+  _numaPolicy = copy._numaPolicy;
+  _numaPlaced = false;
+  _mapped = copy._mapped;
   _indexer = copy._indexer;
 
-  assert(_data);
-  memcpy(_data, copy._data, _size);
+  // Отслеживание изменений начинается заново
+  _dirtyMode = copy._dirtyMode;
+  _tileRows = copy._tileRows;
+  _tileCols = copy._tileCols;
+  _stamps = NULL;
+  _epoch = 1;
+  _log = NULL;
+  _logCount = 0;
+  _logCapacity = 0;
+  memset(_caches, 0, sizeof(_caches));
+
+  if(_size == 0) return;
+
+  _data = _acquire(_size, false);
+  _place(_data, _rowCount, _colCount);
+  _copyData(_data, copy._data, _size / sizeof(TT));
+
+  _retrack();
+}
+
+/*!
+ * \brief Выделить память, заполненную значением по умолчанию
+ *
+ * В ленивом режиме при нулевом значении по умолчанию память берётся у системы
+ * уже обнулённой (calloc, mmap): крупные блоки система отдаёт свежими нулевыми
+ * страницами, которые физически выделяются при первой записи -- на узле NUMA
+ * записавшего потока. В остальных случаях память заполняется параллельно
+ * (см. _fill). Размещение по узлам NUMA назначается до первого касания страниц.
+ * \param rowCount Число строк
+ * \param colCount Число столбцов
+ * \return Указатель на данные
+ */
+Matrix::TT *Matrix::_allocate(
+    TI rowCount,
+    TI colCount)
+{
+  const size_t count = (size_t) rowCount * colCount;
+  const bool zero = _lazy && (_defaultValue == 0) && !signbit(_defaultValue);
+
+  TT *data = _acquire(count * sizeof(TT), zero);
+  _place(data, rowCount, colCount);
+  if(!zero) _fill(data, count, _defaultValue);
+
+  return data;
+}
+
+/*!
+ * \brief Выделить память под данные
+ *
+ * Обычно память берётся из кучи. После назначения политики NUMA (_mapped)
+ * данные выделяются mmap: политика, назначенная страницам кучи, пережила бы
+ * free() и досталась бы посторонним выделениям, а отображение возвращается
+ * системе целиком. Такая память всегда обнулена.
+ * \param size Объём, байт
+ * \param zero Обнулить память
+ * \return Указатель на данные
+ */
+Matrix::TT *Matrix::_acquire(
+    size_t size,
+    bool zero) const
+{
+#ifdef MATRIX_NUMA
+  if(_mapped)
+    {
+      void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      assert(map != MAP_FAILED);
+      return (TT *) map;
+    }
+#endif
+
+  TT *data = (TT *) (zero ? calloc(size, 1) : malloc(size));
+  assert(data);
+  return data;
+}
+
+/*!
+ * \brief Изменить объём памяти данных с сохранением содержимого
+ *
+ * Аналог realloc() для памяти, полученной от _acquire(). Отображение
+ * сохраняет назначенную страницам политику NUMA.
+ * \param data Указатель на данные
+ * \param oldSize Прежний объём, байт
+ * \param size Новый объём, байт
+ * \return Указатель на данные
+ */
+Matrix::TT *Matrix::_reacquire(
+    TT *data,
+    size_t oldSize,
+    size_t size) const
+{
+#ifdef MATRIX_NUMA
+  if(_mapped)
+    {
+      void *map = mremap(data, oldSize, size, MREMAP_MAYMOVE);
+      assert(map != MAP_FAILED);
+      return (TT *) map;
+    }
+#endif
+  (void) oldSize;
+
+  data = (TT *) realloc(data, size);
+  assert(data);
+  return data;
+}
+
+/*!
+ * \brief Освободить память, полученную от _acquire()
+ * \param data Указатель на данные (NULL допускается)
+ * \param size Объём, байт
+ */
+void Matrix::_release(
+    TT *data,
+    size_t size) const
+{
+  if(!data) return;
+
+#ifdef MATRIX_NUMA
+  if(_mapped)
+    {
+      munmap(data, size);
+      return;
+    }
+#endif
+  (void) size;
+
+  free(data);
+}
+
+/*!
+ * \brief Заполнить массив значением
+ *
+ * Цикл векторизуется компилятором, а на больших объёмах делится между потоками
+ * статическими блоками: каждая страница впервые затрагивается тем потоком,
+ * который будет обрабатывать её в последующих параллельных проходах.
+ * \param data Указатель на данные
+ * \param count Число элементов
+ * \param value Значение
+ */
+void Matrix::_fill(
+    TT *data,
+    size_t count,
+    TT value)
+{
+  const int64 n = (int64) count;
+
+#pragma omp parallel for schedule(static) if(n >= MATRIX_PARALLEL_MIN)
+  for(int64 i = 0; i < n; ++i)
+    data[i] = value;
+}
+
+/*!
+ * \brief Назначить размещение памяти по узлам NUMA
+ *
+ * Ещё не затронутые страницы получают политику сразу, уже затронутые
+ * переносятся на нужный узел. Границы полос округляются вверх до страниц:
+ * страница на стыке двух полос относится к предыдущей. При NumaDefault
+ * память, которой политика назначалась, возвращается к политике процесса.
+ *
+ * Полосы закрепляются мягко (MPOL_PREFERRED): если на узле не хватает памяти,
+ * страницы выделяются на других узлах, а не приводят к отказу.
+ * Без libnuma (или без поддержки NUMA в системе) ничего не делает.
+ * Результат сохраняется в _numaPlaced.
+ * \param data Указатель на данные
+ * \param rowCount Число строк
+ * \param colCount Число столбцов
+ */
+void Matrix::_place(
+    TT *data,
+    TI rowCount,
+    TI colCount)
+{
+  _numaPlaced = false;
+
+#ifdef MATRIX_NUMA
+  if(_numaPolicy == NumaDefault)
+    {
+      if(_mapped && (numa_available() >= 0))
+        {
+          const uintptr_t base = (uintptr_t) data;
+          _bind(base, base + (size_t) rowCount * colCount * sizeof(TT), MPOL_DEFAULT, NULL, 0);
+        }
+      return;
+    }
+
+  const int count = _numaNodes(NULL);
+  if(count < 2) return;
+  int *nodes = (int *) malloc(count * sizeof(int));
+  assert(nodes);
+  _numaNodes(nodes);
+
+  const size_t maxNode = (size_t) numa_max_node() + 1;
+  const size_t bits = 8 * sizeof(unsigned long);
+  const size_t words = (maxNode + bits - 1) / bits;
+  unsigned long *mask = (unsigned long *) calloc(words, sizeof(unsigned long));
+  assert(mask);
+
+  const TI major = _storeRows ? rowCount : colCount;
+  const size_t minor = (size_t) (_storeRows ? colCount : rowCount) * sizeof(TT);
+  const uintptr_t base = (uintptr_t) data;
+  bool placed = true;
+
+  if(_numaPolicy == NumaInterleave)
+    {
+      for(int i = 0; i < count; ++i)
+        mask[nodes[i] / bits] |= 1UL << (nodes[i] % bits);
+      placed = _bind(base, base + major * minor, MPOL_INTERLEAVE, mask, maxNode);
+    }
+  else
+    {
+      // Полоса i -- на i-м доступном узле
+      TI bands = _bandCount(major);
+      for(TI band = 0; band < bands; ++band)
+        {
+          TI begin = (TI) ((uint64) major * band / bands);
+          TI end = (TI) ((uint64) major * (band + 1) / bands);
+          memset(mask, 0, words * sizeof(unsigned long));
+          mask[nodes[band] / bits] = 1UL << (nodes[band] % bits);
+          placed = _bind(base + begin * minor, base + end * minor,
+                         MPOL_PREFERRED, mask, maxNode) && placed;
+        }
+    }
+
+  free(mask);
+  free(nodes);
+  _numaPlaced = placed;
+#else
+  (void) data;
+  (void) rowCount;
+  (void) colCount;
+#endif
+}
+
+/*!
+ * \brief Число узлов NUMA
+ *
+ * Учитываются только узлы с памятью, доступные процессу.
+ * Без libnuma или без поддержки NUMA в системе возвращает 1.
+ * \return Число узлов
+ */
+int Matrix::numaNodeCount()
+{
+#ifdef MATRIX_NUMA
+  int count = _numaNodes(NULL);
+  return (count < 1) ? 1 : count;
+#else
+  return 1;
+#endif
+}
+
+/*!
+ * \brief Установить размещение данных по узлам NUMA
+ *
+ * Уже выделенные данные переносятся согласно новой политике; она же
+ * применяется ко всем последующим перевыделениям памяти.
+ * При NumaBands строки (столбцы при хранении столбцами) делятся на
+ * numaNodeCount() полос равной длины; карту полос возвращает numaBand().
+ * \param policy Политика размещения
+ */
+void Matrix::setNumaPolicy(
+    NumaPolicy policy)
+{
+  if(_numaPolicy == policy) return;
+
+  _numaPolicy = policy;
+
+#ifdef MATRIX_NUMA
+  // Данные из кучи переносятся в отображение (см. _acquire)
+  if((policy != NumaDefault) && !_mapped)
+    {
+      _mapped = true;
+      if(isEmpty()) return;
+
+      TT *data = _data;
+      _data = _acquire(_size, false);
+      _place(_data, _rowCount, _colCount);
+      _copyData(_data, data, _size / sizeof(TT));
+      free(data);
+      return;
+    }
+#endif
+
+  if(!isEmpty()) _place(_data, _rowCount, _colCount);
+}
+
+/*!
+ * \brief Число полос в карте размещения
+ * \return Число полос (0 для пустой матрицы)
+ */
+Matrix::TI Matrix::numaBandCount() const
+{
+  if(isEmpty()) return 0;
+  if(_numaPolicy != NumaBands) return 1;
+
+  return _bandCount(_storeRows ? _rowCount : _colCount);
+}
+
+/*!
+ * \brief Полоса карты размещения
+ *
+ * Полосы идут по строкам при хранении строками и по столбцам при хранении
+ * столбцами. Параллельным ядрам достаточно обрабатывать полосу потоками,
+ * привязанными к узлу node. Если размещение не удалось применить (или оно
+ * не поддерживается), node = -1.
+ * \param index Номер полосы
+ * \return Полоса (count = 0 при некорректном номере)
+ */
+Matrix::NumaBand Matrix::numaBand(
+    TI index) const
+{
+  NumaBand band = {0, 0, -1};
+  TI bands = numaBandCount();
+  if(index >= bands) return band;
+
+  TI major = _storeRows ? _rowCount : _colCount;
+  band.begin = (TI) ((uint64) major * index / bands);
+  band.count = (TI) ((uint64) major * (index + 1) / bands) - band.begin;
+#ifdef MATRIX_NUMA
+  // Узел сообщается, только если размещение действительно применено
+  if((_numaPolicy == NumaBands) && _numaPlaced)
+    {
+      int count = _numaNodes(NULL);
+      int *nodes = (int *) malloc(count * sizeof(int));
+      assert(nodes);
+      if(_numaNodes(nodes) == count && (int) index < count) band.node = nodes[index];
+      free(nodes);
+    }
+#endif
+
+  return band;
+}
+
+/*!
+ * \brief Число полос при разбиении по узлам NUMA
+ * \param major Число строк (столбцов при хранении столбцами)
+ * \return Число полос: не больше числа узлов и числа строк (столбцов)
+ */
+Matrix::TI Matrix::_bandCount(
+    TI major)
+{
+  TI nodes = (TI) numaNodeCount();
+  return (major < nodes) ? major : nodes;
+}
+
+/*!
+ * \brief Скопировать массив
+ *
+ * Делится между потоками теми же статическими блоками, что и _fill, поэтому
+ * страницы копии впервые затрагиваются потоками, которые будут их обрабатывать.
+ * \param target Куда
+ * \param source Откуда
+ * \param count Число элементов
+ */
+void Matrix::_copyData(
+    TT *target,
+    const TT *source,
+    size_t count)
+{
+  const int64 n = (int64) count;
+
+#pragma omp parallel for schedule(static) if(n >= MATRIX_PARALLEL_MIN)
+  for(int64 i = 0; i < n; ++i)
+    target[i] = source[i];
+}
+
+/*!
+ * \brief Заполнить все элементы матрицы значением
+ * \param value Значение
+ */
+void Matrix::fill(
+    TT value)
+{
+  if(isEmpty()) return;
+
+  _fill(_data, _size / sizeof(TT), value);
+  if(_stamps) _touchRange(0, _rowCount - 1, 0, _colCount - 1);
 }
 
 /*!
@@ -69,12 +532,14 @@ void Matrix::_copy(
  */
 void Matrix::clear()
 {
-  if(_data) free(_data);
+  _release(_data, _size);
 
   _rowCount = 0;
   _colCount = 0;
   _size = 0;
   _data = NULL;
+
+  _retrack();
 }
 
 /*!
@@ -109,7 +574,8 @@ Matrix *Matrix::part(
       colCount = colEnd - colBeg + 1;
   if((rowCount == _rowCount) && (colCount == _colCount)) return this;
 
-  _size = rowCount * colCount * sizeof(TT);
+  const size_t oldSize = _size;
+  _size = (size_t) rowCount * colCount * sizeof(TT);
 
   if(
      ((colCount == _colCount) && _storeRows)
@@ -123,21 +589,19 @@ Matrix *Matrix::part(
       if((rowBeg == 0) && (colBeg == 0))
         // Обрезка из начала матрицы
         {
-          _data = (TT *) realloc(_data, _size);
-          assert(_data);
+          _data = _reacquire(_data, oldSize, _size);
         }
       else
         // Обрезка не из начала матрицы
         {
           TT *data = _data;
-          _data = (TT *) malloc(_size);
-          assert(_data);
+          _data = _acquire(_size, false);
 
           memcpy(
                 _data,
                 data + _indexer(rowBeg, colBeg, _rowCount, _colCount),
                 _size);
-          free(data);
+          _release(data, oldSize);
         }
     }
 
@@ -149,19 +613,20 @@ Matrix *Matrix::part(
     // Остальные случаи
     {
       TT *data = _data;
-      _data = (TT *) malloc(_size);
-      assert(_data);
+      _data = _acquire(_size, false);
 
       for(TI i = 0; i < rowCount; ++i)
         for(TI j = 0; j < colCount; ++j)
           _data[_indexer(i, j, rowCount, colCount)] =
               data[_indexer(i + rowBeg, j + colBeg, _rowCount, _colCount)];
 
-      free(data);
+      _release(data, oldSize);
     }
 
   _rowCount = rowCount;
   _colCount = colCount;
+  _place(_data, _rowCount, _colCount);
+  _retrack();
 
   return this;
 }
@@ -171,8 +636,9 @@ Matrix *Matrix::part(
  */
 Matrix::~Matrix()
 {
-  if (!_data) return;
-  free(_data);
+  _untrack();
+
+  _release(_data, _size);
 }
 
 /*!
@@ -184,7 +650,8 @@ Matrix &Matrix::operator=(
     const Matrix &copy)
 {
   if(*this == copy) return *this;
-  if(_data) free(_data);
+  _release(_data, _size);
+  _untrack();
 
   _copy(copy);
 
@@ -206,9 +673,11 @@ bool Matrix::operator==(
      )
     return false;
 
+  // Сравнение не должно помечать блоки изменёнными
+  const Matrix &self = *this;
   for(Matrix::TI i = 0; i < rowCount(); ++i)
     for(Matrix::TI j = 0; j < colCount(); ++j)
-      if(o(i, j) != other.o(i, j))
+      if(self.o(i, j) != other.o(i, j))
         return false;
 
   return true;
@@ -226,10 +695,12 @@ Matrix::TT &Matrix::o(
     TI row,
     TI col)
 {
-  return (isEmpty() || (row >= _rowCount) || (col >= _colCount)) ?
-        _NaN
-      :
-        _data[_indexer(row, col, _rowCount, _colCount)];
+  if(isEmpty() || (row >= _rowCount) || (col >= _colCount)) return _NaN;
+
+  // Неконстантный доступ считается записью
+  if(_stamps) _touch(row, col);
+
+  return _data[_indexer(row, col, _rowCount, _colCount)];
 }
 
 Matrix::TT const &Matrix::o(
@@ -243,6 +714,225 @@ Matrix::TT const &Matrix::o(
 }
 
 
+/*!
+ * \brief Получить несколько строк подряд
+ *
+ * Результат содержит строки одну за другой. При хранении строками данные
+ * не копируются.
+ * \param row Номер первой строки
+ * \param count Число строк
+ * \return Блок строк (пустой при некорректном входе)
+ */
+Matrix::Span Matrix::rows(
+    TI row,
+    TI count) const
+{
+  return _span(row, count, true);
+}
+
+/*!
+ * \brief Получить несколько столбцов подряд
+ *
+ * Результат содержит столбцы один за другим. При хранении столбцами данные
+ * не копируются.
+ * \param col Номер первого столбца
+ * \param count Число столбцов
+ * \return Блок столбцов (пустой при некорректном входе)
+ */
+Matrix::Span Matrix::cols(
+    TI col,
+    TI count) const
+{
+  return _span(col, count, false);
+}
+
+Matrix::Span Matrix::_span(
+    TI begin,
+    TI count,
+    bool byRows) const
+{
+  // total -- размерность вдоль оси блока, other -- длина строки (столбца)
+  const TI total = byRows ? _rowCount : _colCount;
+  const TI other = byRows ? _colCount : _rowCount;
+
+  if(isEmpty() || (count == 0) || (begin >= total) || (count > total - begin))
+    // Некорректный ввод
+    return Span();
+
+  if(byRows == _storeRows)
+    // Блок непрерывен
+    return Span(_data + (size_t) begin * other, (size_t) count * other, false);
+
+  // Собрать копию: каждая строка (столбец) хранения даёт по count элементов
+  TT *result = (TT *) malloc((size_t) count * other * sizeof(TT));
+  assert(result);
+
+  const int64 n = other;
+#pragma omp parallel for schedule(static) if((size_t) n * count >= MATRIX_PARALLEL_MIN)
+  for(int64 m = 0; m < n; ++m)
+    {
+      const TT *source = _data + (size_t) m * total + begin;
+      for(TI k = 0; k < count; ++k)
+        result[(size_t) k * other + m] = source[k];
+    }
+
+  return Span(result, (size_t) count * other, true);
+}
+
+/*!
+ * \brief Записать строку
+ * \param row Номер строки
+ * \param values Значения (colCount() элементов)
+ */
+void Matrix::setRow(
+    TI row,
+    const TT *values)
+{
+  _scatter(row, values, true);
+}
+
+/*!
+ * \brief Записать столбец
+ * \param col Номер столбца
+ * \param values Значения (rowCount() элементов)
+ */
+void Matrix::setCol(
+    TI col,
+    const TT *values)
+{
+  _scatter(col, values, false);
+}
+
+void Matrix::_scatter(
+    TI index,
+    const TT *values,
+    bool byRows)
+{
+  const TI total = byRows ? _rowCount : _colCount;
+  const TI other = byRows ? _colCount : _rowCount;
+
+  if(isEmpty() || !values || (index >= total)) return;
+
+  if(_stamps)
+    {
+      if(byRows) _touchRange(index, index, 0, _colCount - 1);
+      else _touchRange(0, _rowCount - 1, index, index);
+    }
+
+  if(byRows == _storeRows)
+    memcpy(_data + (size_t) index * other, values, other * sizeof(TT));
+  else
+    for(TI m = 0; m < other; ++m)
+      _data[(size_t) m * total + index] = values[m];
+}
+
+/*!
+ * \brief Вставить строки
+ *
+ * Новые строки заполняются из values либо значением по умолчанию.
+ * \param row Номер, который получит первая вставленная строка (<= rowCount())
+ * \param count Количество вставляемых строк
+ * \param values Значения строк одна за другой (count * colCount() элементов)
+ * или NULL
+ */
+void Matrix::insertRows(
+    TI row,
+    TI count,
+    const TT *values)
+{
+  _insert(row, count, values, true);
+}
+
+/*!
+ * \brief Вставить столбцы
+ *
+ * Новые столбцы заполняются из values либо значением по умолчанию.
+ * \param col Номер, который получит первый вставленный столбец (<= colCount())
+ * \param count Количество вставляемых столбцов
+ * \param values Значения столбцов один за другим (count * rowCount() элементов)
+ * или NULL
+ */
+void Matrix::insertCols(
+    TI col,
+    TI count,
+    const TT *values)
+{
+  _insert(col, count, values, false);
+}
+
+void Matrix::_insert(
+    TI pos,
+    TI count,
+    const TT *values,
+    bool byRows)
+{
+  const TI total = byRows ? _rowCount : _colCount;
+  const TI other = byRows ? _colCount : _rowCount;
+
+  // У пустой матрицы нет второй размерности
+  if(isEmpty() || (count == 0) || (pos > total)) return;
+
+  const TI
+      newTotal = total + count,
+      rowCount = byRows ? newTotal : _rowCount,
+      colCount = byRows ? _colCount : newTotal;
+  const size_t oldSize = _size;
+  _size = (size_t) newTotal * other * sizeof(TT);
+
+  if(byRows == _storeRows)
+    // Вставка целыми строками при хранении строками
+    // или
+    // Вставка целыми столбцами при хранении столбцами
+    {
+      _data = _reacquire(_data, oldSize, _size);
+      _place(_data, rowCount, colCount);
+
+      TT *block = _data + (size_t) pos * other;
+      if(pos < total)
+        memmove(
+              block + (size_t) count * other,
+              block,
+              (size_t) (total - pos) * other * sizeof(TT)
+              );
+
+      if(values)
+        memcpy(block, values, (size_t) count * other * sizeof(TT));
+      else
+        _fill(block, (size_t) count * other, _defaultValue);
+    }
+  else
+    // Остальные случаи: каждая строка (столбец) хранения собирается из трёх
+    // непрерывных кусков
+    {
+      TT *data = _data;
+      _data = _acquire(_size, false);
+      _place(_data, rowCount, colCount);
+
+      const int64 n = other;
+#pragma omp parallel for schedule(static) if((size_t) n * newTotal >= MATRIX_PARALLEL_MIN)
+      for(int64 m = 0; m < n; ++m)
+        {
+          const TT *source = data + (size_t) m * total;
+          TT *target = _data + (size_t) m * newTotal;
+
+          memcpy(target, source, pos * sizeof(TT));
+          if(values)
+            for(TI k = 0; k < count; ++k)
+              target[pos + k] = values[(size_t) k * other + m];
+          else
+            for(TI k = 0; k < count; ++k)
+              target[pos + k] = _defaultValue;
+          memcpy(target + pos + count, source + pos, (total - pos) * sizeof(TT));
+        }
+
+      _release(data, oldSize);
+    }
+
+  _rowCount = rowCount;
+  _colCount = colCount;
+  _retrack();
+}
+
 /*!
  * \brief Установить способ внутреннего хранения
  *
@@ -278,6 +968,9 @@ void Matrix::setStoreMode(
           data[indexer(i, j, _rowCount, _colCount)];
 
   free(data);
+
+  // Полосы NUMA меняют ориентацию вместе со способом хранения
+  _place(_data, _rowCount, _colCount);
 }
 
 /*!
@@ -298,7 +991,8 @@ void Matrix::deleteRow(
       return;
     }
 
-  _size = _colCount * (_rowCount - count) * sizeof(TT);
+  const size_t oldSize = _size;
+  _size = (size_t) _colCount * (_rowCount - count) * sizeof(TT);
 
   if(_storeRows)
     {
@@ -307,22 +1001,20 @@ void Matrix::deleteRow(
         // "сдвинуть" остальную память на место удаляемого блока
         {
           // Позиция "сдвигаемой" части памяти
-          TI pos = _indexer(row + count, 0, _rowCount, _colCount);
+          size_t pos = _indexer(row + count, 0, _rowCount, _colCount);
           memmove(
                 _data + _indexer(row, 0, _rowCount, _colCount),
                 _data + pos,
-                (_rowCount * _colCount - pos) * sizeof(TT)
+                ((size_t) _rowCount * _colCount - pos) * sizeof(TT)
                 );
         }
-      _data = (TT *) realloc(_data, _size);
-      assert(_data);
+      _data = _reacquire(_data, oldSize, _size);
     }
   else
     {
       TT *data = _data;
 
-      _data = (TT *) malloc(_size);
-      assert(_data);
+      _data = _acquire(_size, false);
 
       for(TI i = 0; i < _rowCount - count; ++i)
         for(TI j = 0; j < _colCount; ++j)
@@ -332,10 +1024,12 @@ void Matrix::deleteRow(
                             _rowCount,
                             _colCount)
               ];
-      free(data);
+      _release(data, oldSize);
     }
 
   _rowCount -= count;
+  _place(_data, _rowCount, _colCount);
+  _retrack();
 }
 
 /*!
@@ -356,7 +1050,8 @@ void Matrix::deleteCol(
       return;
     }
 
-  _size = (_colCount - count) * _rowCount * sizeof(TT);
+  const size_t oldSize = _size;
+  _size = (size_t) (_colCount - count) * _rowCount * sizeof(TT);
 
   if(!_storeRows)
     {
@@ -365,22 +1060,20 @@ void Matrix::deleteCol(
         // "сдвинуть" остальную память на место удаляемого блока
         {
           // Позиция "сдвигаемой" части памяти
-          TI pos = _indexer(0, col + count, _rowCount, _colCount);
+          size_t pos = _indexer(0, col + count, _rowCount, _colCount);
           memmove(
                 _data + _indexer(0, col, _rowCount, _colCount),
                 _data + pos,
-                (_rowCount * _colCount - pos) * sizeof(TT)
+                ((size_t) _rowCount * _colCount - pos) * sizeof(TT)
                 );
         }
-      _data = (TT *) realloc(_data, _size);
-      assert(_data);
+      _data = _reacquire(_data, oldSize, _size);
     }
   else
     {
       TT *data = _data;
 
-      _data = (TT *) malloc(_size);
-      assert(_data);
+      _data = _acquire(_size, false);
 
       for(TI i = 0; i < _rowCount; ++i)
         for(TI j = 0; j < _colCount - count; ++j)
@@ -390,10 +1083,12 @@ void Matrix::deleteCol(
                             _rowCount,
                             _colCount)
               ];
-      free(data);
+      _release(data, oldSize);
     }
 
   _colCount -= count;
+  _place(_data, _rowCount, _colCount);
+  _retrack();
 }
 
 /*!
@@ -418,7 +1113,8 @@ void Matrix::resize(
   // Некоректный ввод
   else if((rowCount == 0) || (colCount == 0)) return;
 
-  _size = rowCount * colCount * sizeof(TT);
+  const size_t oldSize = _size;
+  _size = (size_t) rowCount * colCount * sizeof(TT);
 
   if(
      (colCount == _colCount && _storeRows)
@@ -429,24 +1125,21 @@ void Matrix::resize(
     // или
     // Изменение числа столбцов при хранении столбцами
     {
-      _data = (TT *) realloc(_data, _size);
-      assert(_data);
-
-      if(_rowCount < rowCount)
-        memset(
-              _data + _indexer(_rowCount - 1, _colCount - 1, _rowCount, _colCount) + 1,
-              _defaultValue,
-              (rowCount * colCount - _rowCount * _colCount) * sizeof(TT)
+      _data = _reacquire(_data, oldSize, _size);
+      _place(_data, rowCount, colCount);
+
+      if(_rowCount < rowCount || _colCount < colCount)
+        _fill(
+              _data + (size_t) _rowCount * _colCount,
+              (size_t) rowCount * colCount - (size_t) _rowCount * _colCount,
+              _defaultValue
               );
     }
   else
     // ... остальные случаи
     {
       TT *temp = _data;
-      _data = (TT *) malloc(_size);
-      assert(_data);
-
-      memset(_data, _defaultValue, _size);
+      _data = _allocate(rowCount, colCount);
 
       for(TI i = 0; i < rowCount; ++i)
         for(TI j = 0; j < colCount; ++j)
@@ -454,11 +1147,12 @@ void Matrix::resize(
             _data[_indexer(i, j, rowCount, colCount)] =
                 temp[_indexer(i, j, _rowCount, _colCount)];
 
-      free(temp);
+      _release(temp, oldSize);
     }
 
   _colCount = colCount;
   _rowCount = rowCount;
+  _retrack();
 }
 
 /*!
@@ -614,7 +1308,7 @@ void Matrix::printMatrix(
     {
       for(TI i = 0; i < m->colCount(); ++i)
         {
-          TT value = m->o(j, i);
+          TT value = ((const Matrix *) m)->o(j, i);
           cout << setw(width) << value;
         }
       cout << endl;
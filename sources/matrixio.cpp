@@ -0,0 +1,537 @@
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef MATRIX_LZ4
+#include <lz4.h>
+#endif
+#ifdef MATRIX_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Формат файла (версия 1). Числа записываются в порядке байтов платформы,
+ * при загрузке он сверяется по метке.
+ *
+ * Заголовок:
+ *   char[4]  "MTRX"
+ *   uint32   Версия формата
+ *   uint32   Метка порядка байтов (MATRIX_IO_ORDER)
+ *   uint32   Число строк
+ *   uint32   Число столбцов
+ *   uint8    Признак построчного хранения
+ *   uint8    Размер элемента в байтах
+ *   uint8    Признак вещественного типа
+ *   uint8    Резерв
+ *   real64   Значение по умолчанию
+ *   uint32   Число элементов в блоке
+ *   uint32   Число блоков
+ *
+ * Далее блоки подряд, каждый -- непрерывный участок внутренних данных:
+ *   uint32   Кодек (Matrix::Codec)
+ *   uint32   Число элементов
+ *   uint32   Объём данных блока в файле, байт
+ *   uint32   CRC-32 данных блока в файле
+ *   ...      Данные: как есть (CodecRaw) или сжатые после перестановки байтов
+ */
+
+#define MATRIX_IO_MAGIC "MTRX"
+#define MATRIX_IO_VERSION 1
+#define MATRIX_IO_ORDER 0x01020304u
+#define MATRIX_IO_CHUNK (1 << 17)  // Элементов в блоке
+#define MATRIX_IO_BATCH 64         // Блоков, обрабатываемых параллельно
+
+/*!
+ * \brief Описание блока данных в файле
+ */
+struct MatrixChunk
+{
+  uint32
+  codec,  // Кодек
+  count,  // Число элементов
+  stored, // Объём данных в файле
+  crc;    // Контрольная сумма данных в файле
+
+  uint8 *payload; // Данные в файле
+  bool owned;     // Данные выделены отдельно от матрицы
+};
+
+/*!
+ * \brief CRC-32 (полином 0xEDB88320)
+ * \param data Данные
+ * \param size Объём данных
+ * \return Контрольная сумма
+ */
+static uint32 _crc32(
+    const uint8 *data,
+    size_t size)
+{
+  static struct Table
+  {
+    uint32 t[256];
+    Table()
+    {
+      for(uint32 i = 0; i < 256; ++i)
+        {
+          uint32 c = i;
+          for(int k = 0; k < 8; ++k)
+            c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+          t[i] = c;
+        }
+    }
+  } table;
+
+  uint32 crc = 0xFFFFFFFFu;
+  for(size_t i = 0; i < size; ++i)
+    crc = table.t[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+  return crc ^ 0xFFFFFFFFu;
+}
+
+/*!
+ * \brief Перестановка байтов
+ *
+ * Сначала идут первые байты всех элементов, затем вторые и т.д. Старшие
+ * байты (знак и порядок) у соседних значений обычно совпадают, что заметно
+ * улучшает сжатие.
+ */
+static void _shuffle(
+    const uint8 *source,
+    uint8 *target,
+    size_t count,
+    size_t width)
+{
+  for(size_t b = 0; b < width; ++b)
+    for(size_t i = 0; i < count; ++i)
+      target[b * count + i] = source[i * width + b];
+}
+
+static void _unshuffle(
+    const uint8 *source,
+    uint8 *target,
+    size_t count,
+    size_t width)
+{
+  for(size_t b = 0; b < width; ++b)
+    for(size_t i = 0; i < count; ++i)
+      target[i * width + b] = source[b * count + i];
+}
+
+/*!
+ * \brief Поддерживается ли кодек сборкой
+ */
+static bool _codecAvailable(
+    uint32 codec)
+{
+  switch(codec)
+    {
+    case Matrix::CodecRaw:
+      return true;
+#ifdef MATRIX_LZ4
+    case Matrix::CodecLZ4:
+      return true;
+#endif
+#ifdef MATRIX_ZSTD
+    case Matrix::CodecZstd:
+      return true;
+#endif
+    default:
+      return false;
+    }
+}
+
+/*!
+ * \brief Наибольший объём блока в файле
+ * \param codec Кодек
+ * \param size Объём несжатых данных
+ * \return Граница объёма или 0 для неизвестного кодека
+ */
+static size_t _bound(
+    uint32 codec,
+    size_t size)
+{
+  switch(codec)
+    {
+    case Matrix::CodecRaw:
+      return size;
+#ifdef MATRIX_LZ4
+    case Matrix::CodecLZ4:
+      return (size_t) LZ4_compressBound((int) size);
+#endif
+#ifdef MATRIX_ZSTD
+    case Matrix::CodecZstd:
+      return ZSTD_compressBound(size);
+#endif
+    default:
+      return 0;
+    }
+}
+
+/*!
+ * \brief Сжать блок
+ * \return Объём сжатых данных или 0, если сжать не удалось
+ */
+static size_t _compress(
+    uint32 codec,
+    const uint8 *source,
+    size_t size,
+    uint8 **target)
+{
+  *target = NULL;
+
+  switch(codec)
+    {
+#ifdef MATRIX_LZ4
+    case Matrix::CodecLZ4:
+      {
+        int bound = LZ4_compressBound((int) size);
+        *target = (uint8 *) malloc(bound);
+        assert(*target);
+        int result = LZ4_compress_default(
+              (const char *) source, (char *) *target, (int) size, bound);
+        return (result > 0) ? (size_t) result : 0;
+      }
+#endif
+#ifdef MATRIX_ZSTD
+    case Matrix::CodecZstd:
+      {
+        size_t bound = ZSTD_compressBound(size);
+        *target = (uint8 *) malloc(bound);
+        assert(*target);
+        size_t result = ZSTD_compress(*target, bound, source, size, 1);
+        return ZSTD_isError(result) ? 0 : result;
+      }
+#endif
+    default:
+      (void) source;
+      (void) size;
+      return 0;
+    }
+}
+
+/*!
+ * \brief Распаковать блок
+ * \return Признак успеха (распакован ровно size байт)
+ */
+static bool _decompress(
+    uint32 codec,
+    const uint8 *source,
+    size_t stored,
+    uint8 *target,
+    size_t size)
+{
+  switch(codec)
+    {
+#ifdef MATRIX_LZ4
+    case Matrix::CodecLZ4:
+      return LZ4_decompress_safe(
+            (const char *) source, (char *) target, (int) stored, (int) size)
+          == (int) size;
+#endif
+#ifdef MATRIX_ZSTD
+    case Matrix::CodecZstd:
+      {
+        size_t result = ZSTD_decompress(target, size, source, stored);
+        return !ZSTD_isError(result) && (result == size);
+      }
+#endif
+    default:
+      (void) source;
+      (void) stored;
+      (void) target;
+      (void) size;
+      return false;
+    }
+}
+
+template <typename T>
+static bool _write(
+    FILE *file,
+    const T &value)
+{
+  return fwrite(&value, sizeof(T), 1, file) == 1;
+}
+
+template <typename T>
+static bool _read(
+    FILE *file,
+    T &value)
+{
+  return fread(&value, sizeof(T), 1, file) == 1;
+}
+
+/*!
+ * \brief Сохранить матрицу в файл
+ *
+ * Данные делятся на блоки, которые сжимаются параллельно. Блок, который не
+ * удалось сжать (или который не уменьшился), сохраняется как есть. Если
+ * кодек не поддерживается сборкой, используется CodecRaw.
+ *
+ * Файл сначала пишется под именем path + ".tmp", сбрасывается на диск и только
+ * затем заменяет path, поэтому сбой посреди записи не портит прежний снимок.
+ * \param path Путь к файлу
+ * \param codec Кодек
+ * \return Признак успеха
+ */
+bool Matrix::save(
+    const char *path,
+    Codec codec) const
+{
+  const size_t length = strlen(path);
+  char *temp = (char *) malloc(length + 5);
+  assert(temp);
+  memcpy(temp, path, length);
+  memcpy(temp + length, ".tmp", 5);
+
+  FILE *file = fopen(temp, "wb");
+  if(!file)
+    {
+      free(temp);
+      return false;
+    }
+
+  if(!_codecAvailable(codec)) codec = CodecRaw;
+
+  const size_t count = _size / sizeof(TT);
+  const uint32 chunkCount = (uint32) ((count + MATRIX_IO_CHUNK - 1) / MATRIX_IO_CHUNK);
+  const real64 defaultValue = _defaultValue;
+
+  bool ok =
+      (fwrite(MATRIX_IO_MAGIC, 4, 1, file) == 1) &&
+      _write(file, (uint32) MATRIX_IO_VERSION) &&
+      _write(file, (uint32) MATRIX_IO_ORDER) &&
+      _write(file, (uint32) _rowCount) &&
+      _write(file, (uint32) _colCount) &&
+      _write(file, (uint8) _storeRows) &&
+      _write(file, (uint8) sizeof(TT)) &&
+      _write(file, (uint8) 1) &&
+      _write(file, (uint8) 0) &&
+      _write(file, defaultValue) &&
+      _write(file, (uint32) MATRIX_IO_CHUNK) &&
+      _write(file, chunkCount);
+
+  MatrixChunk chunks[MATRIX_IO_BATCH];
+  for(uint32 first = 0; ok && (first < chunkCount); first += MATRIX_IO_BATCH)
+    {
+      const int batch = (int) ((chunkCount - first < MATRIX_IO_BATCH) ?
+                                 chunkCount - first : MATRIX_IO_BATCH);
+
+      // Подготовить блоки
+#pragma omp parallel for schedule(dynamic)
+      for(int c = 0; c < batch; ++c)
+        {
+          MatrixChunk &chunk = chunks[c];
+          const size_t begin = (size_t) (first + c) * MATRIX_IO_CHUNK;
+          const size_t n = (count - begin < MATRIX_IO_CHUNK) ?
+                count - begin : MATRIX_IO_CHUNK;
+          const size_t size = n * sizeof(TT);
+
+          chunk.codec = CodecRaw;
+          chunk.count = (uint32) n;
+          chunk.stored = (uint32) size;
+          chunk.payload = (uint8 *) (_data + begin);
+          chunk.owned = false;
+
+          if(codec != CodecRaw)
+            {
+              uint8 *shuffled = (uint8 *) malloc(size);
+              assert(shuffled);
+              _shuffle(chunk.payload, shuffled, n, sizeof(TT));
+
+              uint8 *compressed;
+              size_t stored = _compress(codec, shuffled, size, &compressed);
+              free(shuffled);
+
+              if((stored > 0) && (stored < size))
+                {
+                  chunk.codec = codec;
+                  chunk.stored = (uint32) stored;
+                  chunk.payload = compressed;
+                  chunk.owned = true;
+                }
+              else
+                free(compressed);
+            }
+
+          chunk.crc = _crc32(chunk.payload, chunk.stored);
+        }
+
+      // Записать блоки по порядку
+      for(int c = 0; c < batch; ++c)
+        {
+          MatrixChunk &chunk = chunks[c];
+          ok = ok &&
+              _write(file, chunk.codec) &&
+              _write(file, chunk.count) &&
+              _write(file, chunk.stored) &&
+              _write(file, chunk.crc) &&
+              (fwrite(chunk.payload, 1, chunk.stored, file) == chunk.stored);
+          if(chunk.owned) free(chunk.payload);
+        }
+    }
+
+  // Сбросить на диск и атомарно заменить прежний файл
+  ok = ok && (fflush(file) == 0);
+#ifdef _WIN32
+  ok = ok && (_commit(_fileno(file)) == 0);
+#else
+  ok = ok && (fsync(fileno(file)) == 0);
+#endif
+  ok = (fclose(file) == 0) && ok;
+#ifdef _WIN32
+  ok = ok && MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+  ok = ok && (rename(temp, path) == 0);
+#endif
+
+  if(!ok) remove(temp);
+  free(temp);
+  return ok;
+}
+
+/*!
+ * \brief Загрузить матрицу из файла
+ *
+ * Блоки читаются последовательно пачками, проверяются и распаковываются
+ * параллельно прямо во внутренние данные матрицы.
+ * \param path Путь к файлу
+ * \return Матрица или NULL, если файл повреждён, несовместим или содержит
+ * блоки кодека, не поддерживаемого сборкой
+ */
+Matrix *Matrix::load(
+    const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if(!file) return NULL;
+
+  char magic[4];
+  uint32 version, order, rowCount, colCount, chunkSize, chunkCount;
+  uint8 storeRows, width, real, reserved;
+  real64 defaultValue;
+
+  bool ok =
+      (fread(magic, 4, 1, file) == 1) &&
+      (memcmp(magic, MATRIX_IO_MAGIC, 4) == 0) &&
+      _read(file, version) && (version == MATRIX_IO_VERSION) &&
+      _read(file, order) && (order == MATRIX_IO_ORDER) &&
+      _read(file, rowCount) &&
+      _read(file, colCount) &&
+      _read(file, storeRows) &&
+      _read(file, width) && (width == sizeof(TT)) &&
+      _read(file, real) && (real == 1) &&
+      _read(file, reserved) &&
+      _read(file, defaultValue) &&
+      _read(file, chunkSize) && (chunkSize > 0) &&
+      _read(file, chunkCount);
+
+  const size_t count = (size_t) rowCount * colCount;
+  ok = ok && (chunkCount == (count + chunkSize - 1) / chunkSize);
+  if(!ok)
+    {
+      fclose(file);
+      return NULL;
+    }
+
+  Matrix *result = new Matrix(storeRows != 0);
+  result->_defaultValue = defaultValue;
+  if(count == 0)
+    {
+      fclose(file);
+      return result;
+    }
+
+  result->_rowCount = rowCount;
+  result->_colCount = colCount;
+  result->_size = count * sizeof(TT);
+  // Каждый элемент записывается ниже (иначе загрузка не удаётся целиком),
+  // поэтому память не заполняется значением по умолчанию
+  result->_data = result->_acquire(result->_size, false);
+  result->_place(result->_data, rowCount, colCount);
+
+  MatrixChunk chunks[MATRIX_IO_BATCH];
+  for(uint32 first = 0; ok && (first < chunkCount); first += MATRIX_IO_BATCH)
+    {
+      const int batch = (int) ((chunkCount - first < MATRIX_IO_BATCH) ?
+                                 chunkCount - first : MATRIX_IO_BATCH);
+
+      // Прочитать блоки по порядку; несжатые -- сразу на место.
+      // read -- число полностью прочитанных блоков
+      int read = 0;
+      while(ok && (read < batch))
+        {
+          MatrixChunk &chunk = chunks[read];
+          const size_t begin = (size_t) (first + read) * chunkSize;
+          const size_t n = (count - begin < chunkSize) ? count - begin : chunkSize;
+
+          ok =
+              _read(file, chunk.codec) && _codecAvailable(chunk.codec) &&
+              _read(file, chunk.count) && (chunk.count == n) &&
+              _read(file, chunk.stored) && _read(file, chunk.crc) &&
+              (chunk.stored > 0) &&
+              (chunk.stored <= _bound(chunk.codec, n * sizeof(TT))) &&
+              ((chunk.codec != CodecRaw) || (chunk.stored == n * sizeof(TT)));
+          if(!ok) break;
+
+          chunk.owned = (chunk.codec != CodecRaw);
+          chunk.payload = chunk.owned ?
+                (uint8 *) malloc(chunk.stored)
+              :
+                (uint8 *) (result->_data + begin);
+          assert(chunk.payload);
+
+          ok = (fread(chunk.payload, 1, chunk.stored, file) == chunk.stored);
+          if(!ok)
+            {
+              if(chunk.owned) free(chunk.payload);
+              break;
+            }
+          ++read;
+        }
+
+      // Проверить и распаковать
+      bool valid = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&:valid)
+      for(int c = 0; c < read; ++c)
+        {
+          MatrixChunk &chunk = chunks[c];
+          const size_t begin = (size_t) (first + c) * chunkSize;
+
+          bool chunkValid = _crc32(chunk.payload, chunk.stored) == chunk.crc;
+          if(chunkValid && chunk.owned)
+            {
+              const size_t size = (size_t) chunk.count * sizeof(TT);
+              uint8 *shuffled = (uint8 *) malloc(size);
+              assert(shuffled);
+              chunkValid = _decompress(chunk.codec, chunk.payload, chunk.stored,
+                                       shuffled, size);
+              if(chunkValid)
+                _unshuffle(shuffled, (uint8 *) (result->_data + begin),
+                           chunk.count, sizeof(TT));
+              free(shuffled);
+            }
+          if(chunk.owned) free(chunk.payload);
+
+          valid = valid && chunkValid;
+        }
+      ok = ok && valid;
+    }
+
+  fclose(file);
+  if(!ok)
+    {
+      delete result;
+      return NULL;
+    }
+
+  return result;
+}
@@ -0,0 +1,611 @@
+#include "matrix.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Задачи (#pragma omp task) появились в OpenMP 3.0; без них (например, OpenMP
+// 2.0 в MSVC) быстрое умножение распараллеливается только по данным
+#if defined(_OPENMP) && (_OPENMP >= 200805)
+#define MATRIX_MUL_TASKS
+#endif
+
+// Размеры блоков классического умножения (строки A, общая размерность, столбцы B)
+#define MATRIX_MUL_TILE_I 64
+#define MATRIX_MUL_TILE_K 256
+#define MATRIX_MUL_TILE_J 512
+// Минимальное число элементов, начиная с которого поэлементные операции
+// выполняются параллельно
+#define MATRIX_MUL_GRAIN (1 << 14)
+// Предел рабочей памяти быстрого умножения (в размерах результата)
+#define MATRIX_MUL_SCRATCH 2
+
+/*!
+ * \brief Представление матрицы без копирования
+ *
+ * Элемент (i, j) -- data[i * rowStep + j * colStep]. Подходит для обоих
+ * способов хранения и для любых прямоугольных частей (квадрантов).
+ */
+struct MatrixView
+{
+  Matrix::TT *data;
+  size_t rowStep, colStep;
+
+  Matrix::TT &at(
+      size_t row,
+      size_t col) const {return data[row * rowStep + col * colStep];}
+
+  MatrixView part(
+      size_t row,
+      size_t col) const
+  {
+    MatrixView result = {data + row * rowStep + col * colStep, rowStep, colStep};
+    return result;
+  }
+};
+
+/*!
+ * \brief Параметры быстрого умножения
+ */
+struct MatrixMulPlan
+{
+  Matrix::TI cutoff;  // Размер, до которого умножение классическое
+  Matrix::TI depth;   // Наибольшая глубина рекурсии
+  Matrix::TI first;   // Первый уровень, подпроизведения которого -- задачи
+  Matrix::TI tasks;   // Число таких уровней подряд
+};
+
+/*!
+ * \brief Классическое блочное умножение C = A * B
+ *
+ * Блоки A и B упаковываются в непрерывные буферы, внутренний цикл
+ * векторизуется по строке C. Полосы строк C обрабатываются параллельно.
+ * \param a Множитель m x k
+ * \param b Множитель k x n
+ * \param c Результат m x n (colStep = 1)
+ * \param parallel Разрешить параллельный регион (false внутри задачи)
+ */
+static void _gemm(
+    const MatrixView &a,
+    const MatrixView &b,
+    const MatrixView &c,
+    size_t m,
+    size_t k,
+    size_t n,
+    bool parallel)
+{
+  assert(c.colStep == 1);
+  const int64 tiles = (int64) ((m + MATRIX_MUL_TILE_I - 1) / MATRIX_MUL_TILE_I);
+
+#pragma omp parallel if(parallel && tiles > 1)
+  {
+    Matrix::TT
+        *packA = (Matrix::TT *) malloc(MATRIX_MUL_TILE_I * MATRIX_MUL_TILE_K * sizeof(Matrix::TT)),
+        *packB = (Matrix::TT *) malloc(MATRIX_MUL_TILE_K * MATRIX_MUL_TILE_J * sizeof(Matrix::TT));
+    assert(packA && packB);
+
+#pragma omp for schedule(dynamic)
+    for(int64 t = 0; t < tiles; ++t)
+      {
+        const size_t i0 = t * MATRIX_MUL_TILE_I;
+        const size_t ib = (m - i0 < MATRIX_MUL_TILE_I) ? m - i0 : MATRIX_MUL_TILE_I;
+
+        for(size_t i = 0; i < ib; ++i)
+          memset(&c.at(i0 + i, 0), 0, n * sizeof(Matrix::TT));
+
+        for(size_t k0 = 0; k0 < k; k0 += MATRIX_MUL_TILE_K)
+          {
+            const size_t kb = (k - k0 < MATRIX_MUL_TILE_K) ? k - k0 : MATRIX_MUL_TILE_K;
+            for(size_t i = 0; i < ib; ++i)
+              for(size_t kk = 0; kk < kb; ++kk)
+                packA[i * kb + kk] = a.at(i0 + i, k0 + kk);
+
+            for(size_t j0 = 0; j0 < n; j0 += MATRIX_MUL_TILE_J)
+              {
+                const size_t jb = (n - j0 < MATRIX_MUL_TILE_J) ? n - j0 : MATRIX_MUL_TILE_J;
+                for(size_t kk = 0; kk < kb; ++kk)
+                  for(size_t j = 0; j < jb; ++j)
+                    packB[kk * jb + j] = b.at(k0 + kk, j0 + j);
+
+                for(size_t i = 0; i < ib; ++i)
+                  {
+                    Matrix::TT *row = &c.at(i0 + i, j0);
+                    for(size_t kk = 0; kk < kb; ++kk)
+                      {
+                        const Matrix::TT value = packA[i * kb + kk];
+                        const Matrix::TT *line = packB + kk * jb;
+                        for(size_t j = 0; j < jb; ++j)
+                          row[j] += value * line[j];
+                      }
+                  }
+              }
+          }
+      }
+
+    free(packA);
+    free(packB);
+  }
+}
+
+/*!
+ * \brief Поэлементно z = x + sign * y
+ *
+ * z может совпадать с x или y.
+ * \param parallel Разрешить параллельный регион (false внутри задачи)
+ */
+static void _add(
+    const MatrixView &x,
+    const MatrixView &y,
+    const MatrixView &z,
+    size_t rows,
+    size_t cols,
+    Matrix::TT sign,
+    bool parallel)
+{
+  const int64 n = (int64) rows;
+
+#pragma omp parallel for if(parallel && rows * cols >= MATRIX_MUL_GRAIN)
+  for(int64 i = 0; i < n; ++i)
+    {
+      Matrix::TT *target = &z.at(i, 0);
+      for(size_t j = 0; j < cols; ++j)
+        target[j] = x.at(i, j) + sign * y.at(i, j);
+    }
+}
+
+/*!
+ * \brief Дополнить произведение чётных частей до C = A * B
+ *
+ * Нечётные размеры обрабатываются динамическим отсечением (dynamic peeling):
+ * рекурсия считает C' = A' * B' для чётных частей m' x k' и k' x n', затем
+ * при нечётном k к C' прибавляется внешнее произведение последнего столбца A
+ * и последней строки B (обновление ранга 1), а последний столбец и последняя
+ * строка C при нечётных n и m вычисляются умножением матрицы на вектор.
+ * \param parallel Разрешить параллельные регионы (false внутри задачи)
+ */
+static void _peel(
+    const MatrixView &a,
+    const MatrixView &b,
+    const MatrixView &c,
+    size_t m,
+    size_t k,
+    size_t n,
+    bool parallel)
+{
+  const size_t me = m & ~(size_t) 1, ke = k & ~(size_t) 1, ne = n & ~(size_t) 1;
+  const int64 rows = (int64) me;
+
+  // C'(i, j) += A(i, k - 1) * B(k - 1, j)
+  if(ke != k)
+    {
+#pragma omp parallel for if(parallel && me * ne >= MATRIX_MUL_GRAIN)
+      for(int64 i = 0; i < rows; ++i)
+        {
+          Matrix::TT *target = &c.at(i, 0);
+          const Matrix::TT value = a.at(i, ke);
+          for(size_t j = 0; j < ne; ++j)
+            target[j] += value * b.at(ke, j);
+        }
+    }
+
+  // C(i, n - 1) = A(i, :) * B(:, n - 1)
+  if(ne != n)
+    {
+#pragma omp parallel for if(parallel && me * k >= MATRIX_MUL_GRAIN)
+      for(int64 i = 0; i < rows; ++i)
+        {
+          Matrix::TT sum = 0;
+          for(size_t kk = 0; kk < k; ++kk)
+            sum += a.at(i, kk) * b.at(kk, ne);
+          c.at(i, ne) = sum;
+        }
+    }
+
+  // C(m - 1, :) = A(m - 1, :) * B, по полосам столбцов
+  if(me != m)
+    {
+      const int64 bands = (int64) ((n + MATRIX_MUL_TILE_J - 1) / MATRIX_MUL_TILE_J);
+#pragma omp parallel for if(parallel && n * k >= MATRIX_MUL_GRAIN)
+      for(int64 t = 0; t < bands; ++t)
+        {
+          const size_t j0 = t * MATRIX_MUL_TILE_J;
+          const size_t jb = (n - j0 < MATRIX_MUL_TILE_J) ? n - j0 : MATRIX_MUL_TILE_J;
+          Matrix::TT *target = &c.at(me, j0);
+          memset(target, 0, jb * sizeof(Matrix::TT));
+          for(size_t kk = 0; kk < k; ++kk)
+            {
+              const Matrix::TT value = a.at(me, kk);
+              for(size_t j = 0; j < jb; ++j)
+                target[j] += value * b.at(kk, j0 + j);
+            }
+        }
+    }
+}
+
+/*!
+ * \brief Нужен ли ещё один уровень рекурсии
+ */
+static bool _recurse(
+    size_t m,
+    size_t k,
+    size_t n,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan)
+{
+  return
+      (depth < plan.depth) &&
+      (m > plan.cutoff) && (k > plan.cutoff) && (n > plan.cutoff);
+}
+
+/*!
+ * \brief Выполняются ли подпроизведения уровня параллельными задачами
+ */
+static bool _tasks(
+    Matrix::TI depth,
+    const MatrixMulPlan &plan)
+{
+  return (depth >= plan.first) && (depth - plan.first < plan.tasks);
+}
+
+/*!
+ * \brief Объём рабочей памяти для уровня рекурсии и всех нижележащих
+ *
+ * Последовательному уровню нужны два буфера (для S и T, затем для M1), он
+ * передаёт остаток единственному выполняемому в данный момент подпроизведению.
+ * Уровню с задачами нужны все S, T и три произведения одновременно, и каждая
+ * из семи задач получает собственный остаток.
+ * \return Число элементов
+ */
+static size_t _scratch(
+    size_t m,
+    size_t k,
+    size_t n,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan)
+{
+  if(!_recurse(m, k, n, depth, plan)) return 0;
+
+  const size_t m2 = m / 2, k2 = k / 2, n2 = n / 2;
+  const size_t child = _scratch(m2, k2, n2, depth + 1, plan);
+
+  if(_tasks(depth, plan))
+    return 4 * m2 * k2 + 4 * k2 * n2 + 3 * m2 * n2 + 7 * child;
+
+  return ((k2 > n2) ? m2 * k2 : m2 * n2) + k2 * n2 + child;
+}
+
+static void _winograd(
+    const MatrixView &a,
+    const MatrixView &b,
+    const MatrixView &c,
+    size_t m,
+    size_t k,
+    size_t n,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan,
+    Matrix::TT *scratch,
+    bool inner);
+
+/*!
+ * \brief Уровень Штрассена--Винограда с последовательными подпроизведениями
+ *
+ * Порядок вычислений (Boyer, Dumas, Pernet, Zhou) обходится двумя буферами: X
+ * поочерёдно хранит S3, S1, S2, S4 и M1, Y -- T3, T1, T2, T4; остальные
+ * произведения и суммы накапливаются прямо в квадрантах C.
+ */
+static void _serial(
+    const MatrixView &a,
+    const MatrixView &b,
+    const MatrixView &c,
+    size_t m2,
+    size_t k2,
+    size_t n2,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan,
+    Matrix::TT *scratch,
+    bool inner)
+{
+  const bool parallel = !inner;
+
+  const MatrixView
+      a11 = a, a12 = a.part(0, k2), a21 = a.part(m2, 0), a22 = a.part(m2, k2),
+      b11 = b, b12 = b.part(0, n2), b21 = b.part(k2, 0), b22 = b.part(k2, n2),
+      c11 = c, c12 = c.part(0, n2), c21 = c.part(m2, 0), c22 = c.part(m2, n2);
+
+  const size_t size = (k2 > n2) ? m2 * k2 : m2 * n2;
+  const MatrixView
+      s = {scratch, k2, 1},
+      p = {scratch, n2, 1},
+      t = {scratch + size, n2, 1};
+  Matrix::TT *next = scratch + size + k2 * n2;
+
+  // M7 = S3 T3 -> C21, S3 = A11 - A21, T3 = B22 - B12
+  _add(a11, a21, s, m2, k2, -1, parallel);
+  _add(b22, b12, t, k2, n2, -1, parallel);
+  _winograd(s, t, c21, m2, k2, n2, depth + 1, plan, next, inner);
+  // M5 = S1 T1 -> C22, S1 = A21 + A22, T1 = B12 - B11
+  _add(a21, a22, s, m2, k2, 1, parallel);
+  _add(b12, b11, t, k2, n2, -1, parallel);
+  _winograd(s, t, c22, m2, k2, n2, depth + 1, plan, next, inner);
+  // M6 = S2 T2 -> C12, S2 = S1 - A11, T2 = B22 - T1
+  _add(s, a11, s, m2, k2, -1, parallel);
+  _add(b22, t, t, k2, n2, -1, parallel);
+  _winograd(s, t, c12, m2, k2, n2, depth + 1, plan, next, inner);
+  // M3 = S4 B22 -> C11, S4 = A12 - S2
+  _add(a12, s, s, m2, k2, -1, parallel);
+  _winograd(s, b22, c11, m2, k2, n2, depth + 1, plan, next, inner);
+  // M1 = A11 B11 -> X
+  _winograd(a11, b11, p, m2, k2, n2, depth + 1, plan, next, inner);
+
+  // U2 = M1 + M6 -> C12, U3 = U2 + M7 -> C21, U4 = U2 + M5 -> C12,
+  // C22 = U3 + M5, C12 = U4 + M3
+  _add(p, c12, c12, m2, n2, 1, parallel);
+  _add(c12, c21, c21, m2, n2, 1, parallel);
+  _add(c12, c22, c12, m2, n2, 1, parallel);
+  _add(c21, c22, c22, m2, n2, 1, parallel);
+  _add(c12, c11, c12, m2, n2, 1, parallel);
+
+  // M4 = A22 T4 -> C11, T4 = T2 - B21; C21 = U3 - M4
+  _add(t, b21, t, k2, n2, -1, parallel);
+  _winograd(a22, t, c11, m2, k2, n2, depth + 1, plan, next, inner);
+  _add(c21, c11, c21, m2, n2, -1, parallel);
+
+  // M2 = A12 B21 -> C11; C11 = M1 + M2
+  _winograd(a12, b21, c11, m2, k2, n2, depth + 1, plan, next, inner);
+  _add(p, c11, c11, m2, n2, 1, parallel);
+}
+
+/*!
+ * \brief Запустить семь подпроизведений задачами и дождаться их
+ * \param child Рабочая память одной задачи
+ */
+static void _spawn(
+    const MatrixView *product[7][3],
+    size_t m2,
+    size_t k2,
+    size_t n2,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan,
+    Matrix::TT *scratch,
+    size_t child)
+{
+  for(int i = 0; i < 7; ++i)
+    {
+      Matrix::TT *own = scratch + i * child;
+      const MatrixView &x = *product[i][0], &y = *product[i][1], &z = *product[i][2];
+#ifdef MATRIX_MUL_TASKS
+#pragma omp task firstprivate(own)
+#endif
+      _winograd(x, y, z, m2, k2, n2, depth + 1, plan, own, true);
+    }
+#ifdef MATRIX_MUL_TASKS
+#pragma omp taskwait
+#endif
+}
+
+/*!
+ * \brief Уровень Штрассена--Винограда с параллельными подпроизведениями
+ *
+ * Все суммы S и T вычисляются заранее, семь произведений выполняются
+ * одновременно (четыре -- сразу в квадранты C, три -- в рабочую память), затем
+ * квадранты C собираются за один проход.
+ */
+static void _parallel(
+    const MatrixView &a,
+    const MatrixView &b,
+    const MatrixView &c,
+    size_t m2,
+    size_t k2,
+    size_t n2,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan,
+    Matrix::TT *scratch,
+    bool inner)
+{
+  const bool parallel = !inner;
+
+  const MatrixView
+      a11 = a, a12 = a.part(0, k2), a21 = a.part(m2, 0), a22 = a.part(m2, k2),
+      b11 = b, b12 = b.part(0, n2), b21 = b.part(k2, 0), b22 = b.part(k2, n2),
+      c11 = c, c12 = c.part(0, n2), c21 = c.part(m2, 0), c22 = c.part(m2, n2);
+
+  MatrixView s[4], t[4], p[3];
+  Matrix::TT *next = scratch;
+  for(int i = 0; i < 4; ++i)
+    {
+      MatrixView view = {next, k2, 1};
+      s[i] = view;
+      next += m2 * k2;
+    }
+  for(int i = 0; i < 4; ++i)
+    {
+      MatrixView view = {next, n2, 1};
+      t[i] = view;
+      next += k2 * n2;
+    }
+  for(int i = 0; i < 3; ++i)
+    {
+      MatrixView view = {next, n2, 1};
+      p[i] = view;
+      next += m2 * n2;
+    }
+  const size_t child = _scratch(m2, k2, n2, depth + 1, plan);
+
+  // S1 = A21 + A22, S2 = S1 - A11, S3 = A11 - A21, S4 = A12 - S2
+  _add(a21, a22, s[0], m2, k2, 1, parallel);
+  _add(s[0], a11, s[1], m2, k2, -1, parallel);
+  _add(a11, a21, s[2], m2, k2, -1, parallel);
+  _add(a12, s[1], s[3], m2, k2, -1, parallel);
+  // T1 = B12 - B11, T2 = B22 - T1, T3 = B22 - B12, T4 = T2 - B21
+  _add(b12, b11, t[0], k2, n2, -1, parallel);
+  _add(b22, t[0], t[1], k2, n2, -1, parallel);
+  _add(b22, b12, t[2], k2, n2, -1, parallel);
+  _add(t[1], b21, t[3], k2, n2, -1, parallel);
+
+  // M1 = A11 B11 -> P0, M2 = A12 B21 -> C11, M3 = S4 B22 -> C12,
+  // M4 = A22 T4 -> P1, M5 = S1 T1 -> C22, M6 = S2 T2 -> P2, M7 = S3 T3 -> C21
+  const MatrixView *product[7][3] =
+  {
+    {&a11, &b11, &p[0]},
+    {&a12, &b21, &c11},
+    {&s[3], &b22, &c12},
+    {&a22, &t[3], &p[1]},
+    {&s[0], &t[0], &c22},
+    {&s[1], &t[1], &p[2]},
+    {&s[2], &t[2], &c21}
+  };
+  if(inner)
+    _spawn(product, m2, k2, n2, depth, plan, next, child);
+  else
+    {
+#pragma omp parallel
+#pragma omp single
+      _spawn(product, m2, k2, n2, depth, plan, next, child);
+    }
+
+  // C11 = M1 + M2, U2 = M1 + M6, U3 = U2 + M7,
+  // C12 = U2 + M5 + M3, C21 = U3 - M4, C22 = U3 + M5
+  const int64 rows = (int64) m2;
+#pragma omp parallel for if(parallel && m2 * n2 >= MATRIX_MUL_GRAIN)
+  for(int64 i = 0; i < rows; ++i)
+    {
+      Matrix::TT
+          *r11 = &c11.at(i, 0), *r12 = &c12.at(i, 0),
+          *r21 = &c21.at(i, 0), *r22 = &c22.at(i, 0);
+      const Matrix::TT
+          *m1 = &p[0].at(i, 0), *m4 = &p[1].at(i, 0), *m6 = &p[2].at(i, 0);
+      for(size_t j = 0; j < n2; ++j)
+        {
+          const Matrix::TT u2 = m1[j] + m6[j], u3 = u2 + r21[j], m5 = r22[j];
+          r11[j] += m1[j];
+          r12[j] += u2 + m5;
+          r21[j] = u3 - m4[j];
+          r22[j] = u3 + m5;
+        }
+    }
+}
+
+/*!
+ * \brief Умножение Штрассена--Винограда C = A * B
+ *
+ * 7 умножений и 15 сложений квадрантов вместо 8 умножений. Квадранты A, B и C
+ * -- представления без копирования; промежуточные суммы и произведения
+ * размещаются в заранее выделенной рабочей памяти. При нечётных размерах
+ * рекурсия идёт по чётной части, остаток досчитывается _peel().
+ * \param scratch Рабочая память (см. _scratch)
+ * \param inner Вызов внутри задачи: параллельные регионы не открываются
+ */
+static void _winograd(
+    const MatrixView &a,
+    const MatrixView &b,
+    const MatrixView &c,
+    size_t m,
+    size_t k,
+    size_t n,
+    Matrix::TI depth,
+    const MatrixMulPlan &plan,
+    Matrix::TT *scratch,
+    bool inner)
+{
+  if(!_recurse(m, k, n, depth, plan))
+    {
+      _gemm(a, b, c, m, k, n, !inner);
+      return;
+    }
+
+  if(_tasks(depth, plan))
+    _parallel(a, b, c, m / 2, k / 2, n / 2, depth, plan, scratch, inner);
+  else
+    _serial(a, b, c, m / 2, k / 2, n / 2, depth, plan, scratch, inner);
+
+  _peel(a, b, c, m, k, n, !inner);
+}
+
+/*!
+ * \brief Перемножить матрицы
+ *
+ * По умолчанию используется классическое блочное умножение. При fast = true
+ * применяется рекурсивная схема Штрассена--Винограда: квадранты берутся без
+ * копирования, рабочая память выделяется один раз. Рекурсия продолжается, пока
+ * все размерности больше cutoff, но не глубже maxDepth уровней; нечётные
+ * размеры обрабатываются отсечением последней строки (столбца).
+ *
+ * Подпроизведения нескольких уровней подряд выполняются параллельными
+ * задачами (столько уровней, чтобы задач было не меньше потоков). Задачи
+ * требуют отдельной рабочей памяти, поэтому уровни с задачами выбираются так,
+ * чтобы она не превышала MATRIX_MUL_SCRATCH размеров результата: при нехватке
+ * задачи переносятся глубже, а затем их уровней становится меньше. Остальные
+ * уровни последовательны и распараллеливаются по данным.
+ *
+ * Каждый уровень ускоряет умножение примерно на 8/7, но увеличивает
+ * погрешность округления; maxDepth = 0 даёт классический результат.
+ * \param a Левый множитель
+ * \param b Правый множитель
+ * \param fast Использовать схему Штрассена--Винограда
+ * \param cutoff Размер, начиная с которого умножение классическое
+ * \param maxDepth Наибольшая глубина рекурсии
+ * \return Произведение (хранится строками) или NULL, если размеры не согласованы
+ */
+Matrix *Matrix::multiply(
+    const Matrix &a,
+    const Matrix &b,
+    bool fast,
+    TI cutoff,
+    TI maxDepth)
+{
+  if(a.isEmpty() || b.isEmpty() || (a._colCount != b._rowCount)) return NULL;
+
+  const size_t m = a._rowCount, k = a._colCount, n = b._colCount;
+  Matrix *result = new Matrix((TI) m, (TI) n, true, 0, true);
+
+  MatrixView
+      viewA = {a._data, a._storeRows ? k : 1, a._storeRows ? 1 : m},
+      viewB = {b._data, b._storeRows ? n : 1, b._storeRows ? 1 : k},
+      viewC = {result->_data, n, 1};
+
+  MatrixMulPlan plan = {cutoff < 1 ? 1 : cutoff, fast ? maxDepth : 0, 0, 0};
+  if(!_recurse(m, k, n, 0, plan))
+    {
+      _gemm(viewA, viewB, viewC, m, k, n, true);
+      return result;
+    }
+
+#ifdef MATRIX_MUL_TASKS
+  // Число уровней рекурсии и уровней с задачами, нужных для загрузки потоков
+  TI levels = 0, wanted = 0;
+  for(size_t i = m, j = k, l = n; _recurse(i, j, l, levels, plan); i /= 2, j /= 2, l /= 2)
+    ++levels;
+  for(int tasks = 1; tasks < omp_get_max_threads(); tasks *= 7)
+    ++wanted;
+  if(wanted > levels) wanted = levels;
+
+  // Последовательной схеме предел не ставится: меньше памяти ей не нужно
+  size_t limit = MATRIX_MUL_SCRATCH * m * n;
+  const size_t least = _scratch(m, k, n, 0, plan);
+  if(limit < least) limit = least;
+
+  for(TI count = wanted; (count > 0) && (plan.tasks == 0); --count)
+    for(TI first = 0; first + count <= levels; ++first)
+      {
+        MatrixMulPlan trial = plan;
+        trial.first = first;
+        trial.tasks = count;
+        if(_scratch(m, k, n, 0, trial) > limit) continue;
+
+        plan = trial;
+        break;
+      }
+#endif
+
+  TT *scratch = (TT *) malloc(_scratch(m, k, n, 0, plan) * sizeof(TT));
+  assert(scratch);
+
+  _winograd(viewA, viewB, viewC, m, k, n, 0, plan, scratch, false);
+
+  free(scratch);
+  return result;
+}
@@ -0,0 +1,402 @@
+#include "matrix.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <assert.h>
+#include <algorithm>
+
+// Минимальная длина, начиная с которой сортировка распараллеливается
+#define MATRIX_SORT_PARALLEL_MIN (1 << 16)
+// Наибольшее число независимо сортируемых частей
+#define MATRIX_SORT_PARTS 64
+
+/*!
+ * \brief Элемент сортировки с индексом
+ */
+struct MatrixSortItem
+{
+  Matrix::TT key;
+  Matrix::TI index;
+};
+
+static Matrix::TT _key(
+    const Matrix::TT &value) {return value;}
+static Matrix::TT _key(
+    const MatrixSortItem &item) {return item.key;}
+
+/*!
+ * \brief Устойчивая сортировка слиянием
+ *
+ * Короткие массивы сортируются std::stable_sort (на малых участках -- сортировка
+ * вставками). Длинные делятся на части, которые сортируются параллельно и
+ * затем попарно сливаются, также параллельно, через буфер.
+ * \param data Данные
+ * \param count Число элементов
+ * \param less Сравнение
+ * \param buffer Буфер не меньше count элементов
+ */
+template <typename T, typename Less>
+static void _mergeSort(
+    T *data,
+    size_t count,
+    Less less,
+    T *buffer)
+{
+  if(count < MATRIX_SORT_PARALLEL_MIN)
+    {
+      std::stable_sort(data, data + count, less);
+      return;
+    }
+
+  int parts = (int) (count / (MATRIX_SORT_PARALLEL_MIN / 2));
+  if(parts > MATRIX_SORT_PARTS) parts = MATRIX_SORT_PARTS;
+  const size_t width = (count + parts - 1) / parts;
+
+#pragma omp parallel for schedule(dynamic)
+  for(int p = 0; p < parts; ++p)
+    {
+      size_t begin = p * width;
+      size_t end = std::min(count, begin + width);
+      if(begin < end) std::stable_sort(data + begin, data + end, less);
+    }
+
+  // Слияние отсортированных участков длины run
+  T *source = data, *target = buffer;
+  for(size_t run = width; run < count; run *= 2)
+    {
+      const int64 pairs = (int64) ((count + 2 * run - 1) / (2 * run));
+#pragma omp parallel for schedule(dynamic)
+      for(int64 p = 0; p < pairs; ++p)
+        {
+          size_t begin = p * 2 * run;
+          size_t middle = std::min(count, begin + run);
+          size_t end = std::min(count, begin + 2 * run);
+          std::merge(source + begin, source + middle,
+                     source + middle, source + end,
+                     target + begin, less);
+        }
+      std::swap(source, target);
+    }
+
+  if(source != data) memcpy(data, source, count * sizeof(T));
+}
+
+/*!
+ * \brief Отсортировать последовательность, NaN -- в конце
+ *
+ * NaN (отсутствующие значения) устойчиво переносятся в конец, остальное
+ * сортируется обычным сравнением без проверок на NaN.
+ * \param data Данные
+ * \param count Число элементов
+ * \param descending Признак сортировки по убыванию
+ * \param buffer Буфер не меньше count элементов
+ */
+template <typename T>
+static void _sortLine(
+    T *data,
+    size_t count,
+    bool descending,
+    T *buffer)
+{
+  size_t numbers = 0, nans = 0;
+  for(size_t i = 0; i < count; ++i)
+    if(std::isnan(_key(data[i])))
+      buffer[nans++] = data[i];
+    else
+      data[numbers++] = data[i];
+  memcpy(data + numbers, buffer, nans * sizeof(T));
+
+  if(descending)
+    _mergeSort(data, numbers,
+               [](const T &a, const T &b) {return _key(a) > _key(b);}, buffer);
+  else
+    _mergeSort(data, numbers,
+               [](const T &a, const T &b) {return _key(a) < _key(b);}, buffer);
+}
+
+/*!
+ * \brief Упорядочить элементы внутри строк (столбцов)
+ *
+ * Каждая строка (столбец) сортируется независимо; строки обрабатываются
+ * параллельно. NaN всегда оказываются в конце.
+ * \param alongRows Сортировать строки (иначе -- столбцы)
+ * \param descending Признак сортировки по убыванию
+ */
+void Matrix::sort(
+    bool alongRows,
+    bool descending)
+{
+  if(isEmpty()) return;
+
+  const TI lines = alongRows ? _rowCount : _colCount;
+  const TI length = alongRows ? _colCount : _rowCount;
+  const bool contiguous = (alongRows == _storeRows);
+  // Шаг между соседними элементами строки (столбца) и между строками (столбцами)
+  const size_t
+      itemStep = contiguous ? 1 : lines,
+      lineStep = contiguous ? length : 1;
+
+  // Длинные строки сортируются параллельно изнутри (см. _mergeSort)
+#pragma omp parallel if(length < MATRIX_SORT_PARALLEL_MIN)
+  {
+    TT *buffer = (TT *) malloc(length * sizeof(TT));
+    TT *line = contiguous ? NULL : (TT *) malloc(length * sizeof(TT));
+    assert(buffer && (contiguous || line));
+
+#pragma omp for schedule(dynamic, 64)
+    for(int64 l = 0; l < (int64) lines; ++l)
+      {
+        TT *p = _data + l * lineStep;
+        if(contiguous)
+          _sortLine(p, length, descending, buffer);
+        else
+          {
+            for(TI k = 0; k < length; ++k) line[k] = p[k * itemStep];
+            _sortLine(line, length, descending, buffer);
+            for(TI k = 0; k < length; ++k) p[k * itemStep] = line[k];
+          }
+      }
+
+    free(buffer);
+    if(line) free(line);
+  }
+
+  if(_stamps) _touchRange(0, _rowCount - 1, 0, _colCount - 1);
+}
+
+/*!
+ * \brief Индексы, упорядочивающие строки (столбцы)
+ *
+ * Сортировка устойчива, NaN -- в конце.
+ * \param alongRows Упорядочивать строки (иначе -- столбцы)
+ * \param descending Признак сортировки по убыванию
+ * \return Индексы построчно (rowCount() x colCount()) или постолбцово
+ * (colCount() x rowCount()); NULL для пустой матрицы
+ */
+Matrix::TI *Matrix::argsort(
+    bool alongRows,
+    bool descending) const
+{
+  if(isEmpty()) return NULL;
+
+  const TI lines = alongRows ? _rowCount : _colCount;
+  const TI length = alongRows ? _colCount : _rowCount;
+  const bool contiguous = (alongRows == _storeRows);
+  const size_t
+      itemStep = contiguous ? 1 : lines,
+      lineStep = contiguous ? length : 1;
+
+  TI *result = (TI *) malloc((size_t) lines * length * sizeof(TI));
+  assert(result);
+
+#pragma omp parallel if(length < MATRIX_SORT_PARALLEL_MIN)
+  {
+    MatrixSortItem *items = (MatrixSortItem *) malloc(length * sizeof(MatrixSortItem));
+    MatrixSortItem *buffer = (MatrixSortItem *) malloc(length * sizeof(MatrixSortItem));
+    assert(items && buffer);
+
+#pragma omp for schedule(dynamic, 64)
+    for(int64 l = 0; l < (int64) lines; ++l)
+      {
+        const TT *p = _data + l * lineStep;
+        for(TI k = 0; k < length; ++k)
+          {
+            items[k].key = p[k * itemStep];
+            items[k].index = k;
+          }
+        _sortLine(items, length, descending, buffer);
+
+        TI *target = result + (size_t) l * length;
+        for(TI k = 0; k < length; ++k) target[k] = items[k].index;
+      }
+
+    free(items);
+    free(buffer);
+  }
+
+  return result;
+}
+
+/*!
+ * \brief Индексы k наибольших (наименьших) элементов строк (столбцов)
+ *
+ * Индексы каждой строки (столбца) упорядочены; NaN выбираются последними.
+ * \param k Число элементов (ограничивается длиной строки/столбца)
+ * \param alongRows Выбирать в строках (иначе -- в столбцах)
+ * \param descending Выбирать наибольшие (иначе -- наименьшие)
+ * \return Индексы построчно (rowCount() x k) или постолбцово (colCount() x k);
+ * NULL для пустой матрицы или k = 0
+ */
+Matrix::TI *Matrix::topK(
+    TI k,
+    bool alongRows,
+    bool descending) const
+{
+  if(isEmpty() || (k == 0)) return NULL;
+
+  const TI lines = alongRows ? _rowCount : _colCount;
+  const TI length = alongRows ? _colCount : _rowCount;
+  const bool contiguous = (alongRows == _storeRows);
+  const size_t
+      itemStep = contiguous ? 1 : lines,
+      lineStep = contiguous ? length : 1;
+  if(k > length) k = length;
+
+  TI *result = (TI *) malloc((size_t) lines * k * sizeof(TI));
+  assert(result);
+
+  // NaN считаются хуже любого числа, при равенстве раньше меньший индекс
+  auto better = [descending](const MatrixSortItem &a, const MatrixSortItem &b)
+  {
+    if(std::isnan(a.key) || std::isnan(b.key))
+      return std::isnan(b.key) && (!std::isnan(a.key) || (a.index < b.index));
+    if(a.key == b.key) return a.index < b.index;
+    return descending ? (a.key > b.key) : (a.key < b.key);
+  };
+
+  // Буфер выделяется только потоками, которым досталась хотя бы одна строка
+  // (столбец): при малом числе строк длинные буферы не множатся по потокам
+#pragma omp parallel if(lines > 1)
+  {
+    MatrixSortItem *items = NULL;
+
+#pragma omp for schedule(dynamic, 64)
+    for(int64 l = 0; l < (int64) lines; ++l)
+      {
+        if(!items)
+          {
+            items = (MatrixSortItem *) malloc(length * sizeof(MatrixSortItem));
+            assert(items);
+          }
+
+        const TT *p = _data + l * lineStep;
+        for(TI i = 0; i < length; ++i)
+          {
+            items[i].key = p[i * itemStep];
+            items[i].index = i;
+          }
+
+        // Отбор за линейное время, затем сортировка только отобранных
+        if(k < length) std::nth_element(items, items + k - 1, items + length, better);
+        std::sort(items, items + k, better);
+
+        TI *target = result + (size_t) l * k;
+        for(TI i = 0; i < k; ++i) target[i] = items[i].index;
+      }
+
+    if(items) free(items);
+  }
+
+  return result;
+}
+
+/*!
+ * \brief Переставить строки по значениям столбца
+ *
+ * Порядок устойчив, строки с NaN в ключе -- в конце. Строки переносятся за
+ * один проход.
+ * \param col Номер ключевого столбца
+ * \param descending Признак сортировки по убыванию
+ */
+void Matrix::sortRowsBy(
+    TI col,
+    bool descending)
+{
+  if(isEmpty() || (col >= _colCount)) return;
+
+  MatrixSortItem *items = (MatrixSortItem *) malloc(_rowCount * sizeof(MatrixSortItem));
+  MatrixSortItem *buffer = (MatrixSortItem *) malloc(_rowCount * sizeof(MatrixSortItem));
+  TI *order = (TI *) malloc(_rowCount * sizeof(TI));
+  assert(items && buffer && order);
+
+  for(TI i = 0; i < _rowCount; ++i)
+    {
+      items[i].key = _data[_indexer(i, col, _rowCount, _colCount)];
+      items[i].index = i;
+    }
+  _sortLine(items, _rowCount, descending, buffer);
+  for(TI i = 0; i < _rowCount; ++i) order[i] = items[i].index;
+  free(items);
+  free(buffer);
+
+  _permute(order, true);
+  free(order);
+}
+
+/*!
+ * \brief Переставить столбцы по значениям строки
+ *
+ * Порядок устойчив, столбцы с NaN в ключе -- в конце. Столбцы переносятся за
+ * один проход.
+ * \param row Номер ключевой строки
+ * \param descending Признак сортировки по убыванию
+ */
+void Matrix::sortColsBy(
+    TI row,
+    bool descending)
+{
+  if(isEmpty() || (row >= _rowCount)) return;
+
+  MatrixSortItem *items = (MatrixSortItem *) malloc(_colCount * sizeof(MatrixSortItem));
+  MatrixSortItem *buffer = (MatrixSortItem *) malloc(_colCount * sizeof(MatrixSortItem));
+  TI *order = (TI *) malloc(_colCount * sizeof(TI));
+  assert(items && buffer && order);
+
+  for(TI j = 0; j < _colCount; ++j)
+    {
+      items[j].key = _data[_indexer(row, j, _rowCount, _colCount)];
+      items[j].index = j;
+    }
+  _sortLine(items, _colCount, descending, buffer);
+  for(TI j = 0; j < _colCount; ++j) order[j] = items[j].index;
+  free(items);
+  free(buffer);
+
+  _permute(order, false);
+  free(order);
+}
+
+/*!
+ * \brief Переставить строки (столбцы)
+ *
+ * Новая i-я строка (столбец) -- прежняя order[i]. Данные собираются в новом
+ * буфере за один проход: целыми строками при совпадении со способом хранения,
+ * поэлементно внутри каждой строки хранения -- иначе.
+ * \param order Перестановка
+ * \param rows Переставлять строки (иначе -- столбцы)
+ */
+void Matrix::_permute(
+    const TI *order,
+    bool rows)
+{
+  const TI total = rows ? _rowCount : _colCount;
+  const TI other = rows ? _colCount : _rowCount;
+
+  TT *data = _data;
+  _data = _acquire(_size, false);
+  _place(_data, _rowCount, _colCount);
+
+  if(rows == _storeRows)
+    {
+#pragma omp parallel for schedule(static) if((size_t) total * other >= MATRIX_SORT_PARALLEL_MIN)
+      for(int64 i = 0; i < (int64) total; ++i)
+        memcpy(_data + (size_t) i * other,
+               data + (size_t) order[i] * other,
+               other * sizeof(TT));
+    }
+  else
+    {
+#pragma omp parallel for schedule(static) if((size_t) total * other >= MATRIX_SORT_PARALLEL_MIN)
+      for(int64 m = 0; m < (int64) other; ++m)
+        {
+          const TT *source = data + (size_t) m * total;
+          TT *target = _data + (size_t) m * total;
+          for(TI i = 0; i < total; ++i) target[i] = source[order[i]];
+        }
+    }
+
+  _release(data, _size);
+
+  if(_stamps) _touchRange(0, _rowCount - 1, 0, _colCount - 1);
+}
@@ -0,0 +1,335 @@
+#include "matrix.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <assert.h>
+#include <algorithm>
+
+// Наибольшая ширина полосы итогов и наименьшая длина блока слагаемых свёртки
+#define MATRIX_REDUCE_BAND 64
+
+/*!
+ * \brief Включить отслеживание изменённых областей
+ *
+ * Матрица делится на блоки: полосы по одной строке (DirtyRows), по одному
+ * столбцу (DirtyCols) или прямоугольники tileRows x tileCols (DirtyTiles).
+ * Запись через неконстантный o(), setRow(), setCol() и fill() помечает
+ * затронутые блоки. Изменение размеров (part, resize, delete*, insert*)
+ * сбрасывает отслеживание: все кэшированные свёртки пересчитываются целиком.
+ * \param mode Способ отслеживания
+ * \param tileRows Высота блока (для DirtyTiles)
+ * \param tileCols Ширина блока (для DirtyTiles)
+ */
+void Matrix::setDirtyTracking(
+    DirtyMode mode,
+    TI tileRows,
+    TI tileCols)
+{
+  _dirtyMode = mode;
+  _tileRows = (tileRows == 0) ? 1 : tileRows;
+  _tileCols = (tileCols == 0) ? 1 : tileCols;
+
+  _retrack();
+}
+
+/*!
+ * \brief Изменялся ли блок с элементом после отметки
+ *
+ * Без отслеживания любой элемент считается изменённым.
+ * \param row Номер строки
+ * \param col Номер столбца
+ * \param since Отметка, полученная от checkpoint()
+ * \return Признак изменения (false при некорректном входе)
+ */
+bool Matrix::isDirty(
+    TI row,
+    TI col,
+    uint64 since) const
+{
+  if(isEmpty() || (row >= _rowCount) || (col >= _colCount)) return false;
+  if(!_stamps) return true;
+
+  return _stamps[(size_t) (row / _tileH) * _gridCols + col / _tileW] > since;
+}
+
+/*!
+ * \brief Пометить изменёнными блоки прямоугольной области
+ * \param rowBeg Индекс строки-начала
+ * \param rowEnd Индекс строки-конца
+ * \param colBeg Индекс столбца-начала
+ * \param colEnd Индекс столбца-конца
+ */
+void Matrix::_touchRange(
+    TI rowBeg,
+    TI rowEnd,
+    TI colBeg,
+    TI colEnd)
+{
+  for(TI ti = rowBeg / _tileH; ti <= rowEnd / _tileH; ++ti)
+    for(TI tj = colBeg / _tileW; tj <= colEnd / _tileW; ++tj)
+      _mark((size_t) ti * _gridCols + tj);
+}
+
+/*!
+ * \brief Добавить блок в журнал изменённых блоков
+ *
+ * Вызывается при первой в текущей эпохе записи в блок. Журнал ведётся, только
+ * пока есть действительные кэши свёрток. Если в нём накопилось больше записей,
+ * чем блоков в сетке, выгоднее пересчитать свёртки целиком: журнал
+ * очищается, кэши объявляются недействительными.
+ * \param block Номер блока
+ */
+void Matrix::_append(
+    size_t block)
+{
+  bool cached = false;
+  for(int k = 0; k < ReduceCount; ++k)
+    cached = cached || (_caches[k].seen != 0);
+  if(!cached) return;
+
+  const size_t blocks = (size_t) _gridRows * _gridCols;
+  if(_logCount == blocks)
+    {
+      for(int k = 0; k < ReduceCount; ++k)
+        {
+          _caches[k].seen = 0;
+          _caches[k].logged = 0;
+        }
+      _logCount = 0;
+      return;
+    }
+
+  if(_logCount == _logCapacity)
+    {
+      _logCapacity = (_logCapacity == 0) ? 64 : 2 * _logCapacity;
+      if(_logCapacity > blocks) _logCapacity = blocks;
+      _log = (size_t *) realloc(_log, _logCapacity * sizeof(size_t));
+      assert(_log);
+    }
+  _log[_logCount++] = block;
+}
+
+/*!
+ * \brief Перестроить сетку блоков под текущие размеры
+ *
+ * Кэши свёрток становятся недействительными.
+ */
+void Matrix::_retrack()
+{
+  _untrack();
+
+  if((_dirtyMode == DirtyOff) || isEmpty()) return;
+
+  _tileH = (_dirtyMode == DirtyRows) ? 1 :
+           (_dirtyMode == DirtyCols) ? _rowCount : _tileRows;
+  _tileW = (_dirtyMode == DirtyCols) ? 1 :
+           (_dirtyMode == DirtyRows) ? _colCount : _tileCols;
+  _gridRows = (_rowCount + _tileH - 1) / _tileH;
+  _gridCols = (_colCount + _tileW - 1) / _tileW;
+
+  _stamps = (uint64 *) calloc((size_t) _gridRows * _gridCols, sizeof(uint64));
+  assert(_stamps);
+}
+
+/*!
+ * \brief Освободить сетку блоков и кэши свёрток
+ */
+void Matrix::_untrack()
+{
+  if(_stamps) free(_stamps);
+  _stamps = NULL;
+  _gridRows = 0;
+  _gridCols = 0;
+
+  if(_log) free(_log);
+  _log = NULL;
+  _logCount = 0;
+  _logCapacity = 0;
+
+  for(int k = 0; k < ReduceCount; ++k)
+    {
+      if(_caches[k].partial) free(_caches[k].partial);
+      if(_caches[k].result) free(_caches[k].result);
+    }
+  memset(_caches, 0, sizeof(_caches));
+}
+
+/*!
+ * \brief Вычислить (обновить) свёртку
+ *
+ * Итоги делятся на полосы, слагаемые каждого итога -- на блоки. Для каждой пары
+ * (блок, итог) хранится частичный результат. Сетка вычислений не совпадает с
+ * сеткой отслеживания: полоса не шире MATRIX_REDUCE_BAND итогов (ради
+ * параллельности), блок не короче MATRIX_REDUCE_BAND слагаемых (чтобы
+ * частичные результаты не становились копией матрицы при отслеживании поперёк
+ * оси свёртки). Блоки, изменённые после предыдущего вызова, берутся из журнала
+ * (см. _append) и переносятся на сетку вычислений; пересчитываются только
+ * пересекающиеся с ними пары и итоги затронутых полос, так что работа
+ * пропорциональна изменению, а не размеру матрицы. Без отслеживания свёртка
+ * вычисляется целиком при каждом вызове.
+ * \param kind Вид свёртки
+ * \return Итог: rowCount() (colCount()) значений, действительны до следующего
+ * изменения размеров; NULL для пустой матрицы
+ */
+const Matrix::TT *Matrix::_reduce(
+    Reduction kind)
+{
+  if(isEmpty()) return NULL;
+
+  const bool byRows = (kind == ReduceRowSum) || (kind == ReduceRowNorm);
+  const bool norm = (kind == ReduceRowNorm) || (kind == ReduceColNorm);
+
+  // lines -- число итогов, items -- слагаемых в каждом;
+  // шаги по данным вдоль итога и поперёк
+  const TI
+      lines = byRows ? _rowCount : _colCount,
+      items = byRows ? _colCount : _rowCount;
+  const size_t
+      rowStep = _storeRows ? _colCount : 1,
+      colStep = _storeRows ? 1 : _rowCount,
+      lineStep = byRows ? rowStep : colStep,
+      itemStep = byRows ? colStep : rowStep;
+
+  // Размеры блоков отслеживания вдоль итогов и вдоль слагаемых
+  const TI
+      trackLine = !_stamps ? lines : (byRows ? _tileH : _tileW),
+      trackItem = !_stamps ? items : (byRows ? _tileW : _tileH),
+      lineTile = (trackLine < MATRIX_REDUCE_BAND) ? trackLine : MATRIX_REDUCE_BAND,
+      itemTile = (trackItem > MATRIX_REDUCE_BAND) ? trackItem : MATRIX_REDUCE_BAND,
+      bands = (lines + lineTile - 1) / lineTile,
+      across = (items + itemTile - 1) / itemTile;
+
+  ReductionCache &cache = _caches[kind];
+  if(!cache.result)
+    {
+      cache.result = (TT *) malloc(lines * sizeof(TT));
+      cache.partial = (TT *) malloc((size_t) across * lines * sizeof(TT));
+      assert(cache.result && cache.partial);
+    }
+
+  const bool full = !_stamps || (cache.seen == 0);
+  const size_t logged = cache.logged;
+  cache.seen = checkpoint();
+  cache.logged = _logCount;
+
+  // Частичный результат пары (полоса b, блок a)
+  auto partial = [&](TI b, TI a)
+  {
+    const TI lineBeg = b * lineTile;
+    const TI lineEnd = (lines - lineBeg < lineTile) ? lines : lineBeg + lineTile;
+    const TI itemBeg = a * itemTile;
+    const TI itemEnd = (items - itemBeg < itemTile) ? items : itemBeg + itemTile;
+    for(TI l = lineBeg; l < lineEnd; ++l)
+      {
+        const TT *p = _data + l * lineStep;
+        TT sum = 0;
+        if(norm)
+          for(TI k = itemBeg; k < itemEnd; ++k)
+            sum += p[k * itemStep] * p[k * itemStep];
+        else
+          for(TI k = itemBeg; k < itemEnd; ++k)
+            sum += p[k * itemStep];
+        cache.partial[(size_t) a * lines + l] = sum;
+      }
+  };
+
+  // Итоги полосы b
+  auto total = [&](TI b)
+  {
+    const TI lineBeg = b * lineTile;
+    const TI lineEnd = (lines - lineBeg < lineTile) ? lines : lineBeg + lineTile;
+    // Блоки по порядку, внутри -- подряд по итогам (partial хранится блоками)
+    for(TI l = lineBeg; l < lineEnd; ++l) cache.result[l] = 0;
+    for(TI a = 0; a < across; ++a)
+      {
+        const TT *p = cache.partial + (size_t) a * lines;
+        for(TI l = lineBeg; l < lineEnd; ++l) cache.result[l] += p[l];
+      }
+    if(norm)
+      for(TI l = lineBeg; l < lineEnd; ++l) cache.result[l] = sqrt(cache.result[l]);
+  };
+
+  if(full)
+    {
+      const int64 n = bands;
+#pragma omp parallel for schedule(dynamic)
+      for(int64 b = 0; b < n; ++b)
+        {
+          for(TI a = 0; a < across; ++a) partial((TI) b, a);
+          total((TI) b);
+        }
+    }
+  else
+    {
+      // Пары (полоса, блок), задетые изменёнными блоками, -- номерами
+      // b * across + a, без повторов и по возрастанию
+      size_t count = 0, *pairs = NULL;
+      for(int pass = 0; pass < 2; ++pass)
+        {
+          if(pass == 1)
+            {
+              pairs = (size_t *) malloc((count ? count : 1) * sizeof(size_t));
+              assert(pairs);
+              count = 0;
+            }
+
+          for(size_t e = logged; e < _logCount; ++e)
+            {
+              const TI ti = (TI) (_log[e] / _gridCols), tj = (TI) (_log[e] % _gridCols);
+              const TI
+                  rowBeg = ti * _tileH,
+                  rowEnd = ((_rowCount - rowBeg < _tileH) ? _rowCount : rowBeg + _tileH) - 1,
+                  colBeg = tj * _tileW,
+                  colEnd = ((_colCount - colBeg < _tileW) ? _colCount : colBeg + _tileW) - 1;
+              const TI
+                  bandBeg = (byRows ? rowBeg : colBeg) / lineTile,
+                  bandEnd = (byRows ? rowEnd : colEnd) / lineTile,
+                  acrossBeg = (byRows ? colBeg : rowBeg) / itemTile,
+                  acrossEnd = (byRows ? colEnd : rowEnd) / itemTile;
+              if(pass == 0)
+                {
+                  count += (size_t) (bandEnd - bandBeg + 1) * (acrossEnd - acrossBeg + 1);
+                  continue;
+                }
+              for(TI b = bandBeg; b <= bandEnd; ++b)
+                for(TI a = acrossBeg; a <= acrossEnd; ++a)
+                  pairs[count++] = (size_t) b * across + a;
+            }
+        }
+      std::sort(pairs, pairs + count);
+      count = std::unique(pairs, pairs + count) - pairs;
+
+      // Начала групп пар одной полосы
+      size_t groups = 0, *starts = (size_t *) malloc((count + 1) * sizeof(size_t));
+      assert(starts);
+      for(size_t i = 0; i < count; ++i)
+        if((i == 0) || (pairs[i] / across != pairs[i - 1] / across)) starts[groups++] = i;
+      starts[groups] = count;
+
+      const int64 n = (int64) groups;
+#pragma omp parallel for schedule(dynamic) if(groups > 1)
+      for(int64 g = 0; g < n; ++g)
+        {
+          const TI b = (TI) (pairs[starts[g]] / across);
+          for(size_t i = starts[g]; i < starts[g + 1]; ++i)
+            partial(b, (TI) (pairs[i] % across));
+          total(b);
+        }
+
+      free(starts);
+      free(pairs);
+    }
+
+  // Журнал больше не нужен ни одному кэшу -- очистить
+  bool consumed = true;
+  for(int k = 0; k < ReduceCount; ++k)
+    consumed = consumed && ((_caches[k].seen == 0) || (_caches[k].logged == _logCount));
+  if(consumed)
+    {
+      for(int k = 0; k < ReduceCount; ++k) _caches[k].logged = 0;
+      _logCount = 0;
+    }
+
+  return cache.result;
+}
@@ -0,0 +1,187 @@
+/*!
+ * \file
+ * \brief Проверка сохранения и загрузки: совпадение после загрузки для всех
+ * кодеков и способов хранения, отказ от усечённых и испорченных файлов
+ */
+#include "tests.h"
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+
+#define TEST_IO_PATH "matrix_test.mtx"
+
+/*!
+ * \brief Равны ли значения (NaN равен NaN)
+ */
+static bool _equal(
+    Matrix::TT a,
+    Matrix::TT b)
+{
+  return (a == b) || (std::isnan(a) && std::isnan(b));
+}
+
+/*!
+ * \brief Совпадают ли матрицы (размеры, хранение, значение по умолчанию,
+ * элементы; NaN равен NaN)
+ */
+static bool _same(
+    const Matrix &x,
+    const Matrix &y)
+{
+  if((x.rowCount() != y.rowCount()) || (x.colCount() != y.colCount()) ||
+     (x.storeMode() != y.storeMode()) ||
+     !_equal(x.defaultValue(), y.defaultValue()))
+    return false;
+
+  for(Matrix::TI i = 0; i < x.rowCount(); ++i)
+    for(Matrix::TI j = 0; j < x.colCount(); ++j)
+      if(!_equal(x.o(i, j), y.o(i, j))) return false;
+  return true;
+}
+
+/*!
+ * \brief Прочитать файл целиком
+ * \param size Объём, байт
+ * \return Содержимое (освобождается free()) или NULL
+ */
+static unsigned char *_readFile(
+    size_t *size)
+{
+  FILE *file = fopen(TEST_IO_PATH, "rb");
+  if(!file) return NULL;
+
+  fseek(file, 0, SEEK_END);
+  *size = (size_t) ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  unsigned char *result = (unsigned char *) malloc(*size + 1);
+  if(fread(result, 1, *size, file) != *size)
+    {
+      free(result);
+      result = NULL;
+    }
+  fclose(file);
+  return result;
+}
+
+/*!
+ * \brief Записать файл целиком
+ */
+static void _writeFile(
+    const unsigned char *data,
+    size_t size)
+{
+  FILE *file = fopen(TEST_IO_PATH, "wb");
+  if(!file) return;
+  fwrite(data, 1, size, file);
+  fclose(file);
+}
+
+/*!
+ * \brief Отвергается ли файл при загрузке
+ */
+static bool _rejected()
+{
+  Matrix *loaded = Matrix::load(TEST_IO_PATH);
+  delete loaded;
+  return !loaded;
+}
+
+/*!
+ * \brief Проверить сохранение и загрузку
+ * \return Признак успеха
+ */
+bool testIo()
+{
+  static const Matrix::Codec codecs[] =
+  {
+    Matrix::CodecRaw,
+    Matrix::CodecLZ4,
+    Matrix::CodecZstd
+  };
+  static const char *names[] = {"raw", "lz4", "zstd"};
+
+  bool success = true;
+  char what[128];
+
+  for(int mode = 0; mode < 2; ++mode)
+    for(int c = 0; c < 3; ++c)
+      {
+        // Несколько блоков (MATRIX_IO_CHUNK элементов), хорошо и плохо
+        // сжимаемые участки, NaN
+        Matrix m(400, 700, mode == 0, 2.5);
+        for(Matrix::TI i = 0; i < 400; ++i)
+          for(Matrix::TI j = 0; j < 700; ++j)
+            m.o(i, j) = (i < 200) ? (Matrix::TT) (j % 7) : rand() / (Matrix::TT) RAND_MAX;
+        m.o(3, 4) = NAN;
+        m.o(399, 699) = -0.0;
+
+        const bool saved = m.save(TEST_IO_PATH, codecs[c]);
+        Matrix *loaded = saved ? Matrix::load(TEST_IO_PATH) : NULL;
+        snprintf(what, sizeof(what), "io (%s, %s): round trip",
+                 (mode == 0) ? "rows" : "cols", names[c]);
+        success &= testCheck(loaded && _same(m, *loaded) && std::signbit(((const Matrix *) loaded)->o(399, 699)), what);
+        delete loaded;
+
+        // Временный файл не остаётся
+        FILE *temp = fopen(TEST_IO_PATH ".tmp", "rb");
+        if(temp) fclose(temp);
+        snprintf(what, sizeof(what), "io (%s, %s): no temporary file",
+                 (mode == 0) ? "rows" : "cols", names[c]);
+        success &= testCheck(!temp, what);
+
+        size_t size = 0;
+        unsigned char *data = _readFile(&size);
+        if(!data)
+          {
+            success &= testCheck(false, "io: read saved file");
+            continue;
+          }
+
+        // Усечение на границах заголовка, блока и внутри данных
+        const size_t cuts[] = {0, 3, 39, 40, 41, 56, size / 2, size - 1};
+        bool truncated = true;
+        for(size_t k = 0; k < sizeof(cuts) / sizeof(cuts[0]); ++k)
+          {
+            _writeFile(data, cuts[k]);
+            truncated = truncated && _rejected();
+          }
+        snprintf(what, sizeof(what), "io (%s, %s): truncated file rejected",
+                 (mode == 0) ? "rows" : "cols", names[c]);
+        success &= testCheck(truncated, what);
+
+        // Испорченный байт в заголовке блока или в данных (заголовок файла --
+        // первые 40 байт -- контрольной суммой не защищён)
+        bool flipped = true;
+        for(size_t offset = 40; offset < size; offset += (offset < 64) ? 1 : size / 97)
+          {
+            data[offset] ^= 0x10;
+            _writeFile(data, size);
+            flipped = flipped && _rejected();
+            data[offset] ^= 0x10;
+          }
+        data[size - 1] ^= 0x01;
+        _writeFile(data, size);
+        flipped = flipped && _rejected();
+        snprintf(what, sizeof(what), "io (%s, %s): flipped byte rejected",
+                 (mode == 0) ? "rows" : "cols", names[c]);
+        success &= testCheck(flipped, what);
+
+        free(data);
+      }
+
+  // Пустая матрица сохраняет способ хранения и значение по умолчанию
+  Matrix empty(false);
+  empty.setDefaultValue(-3);
+  Matrix *loaded = empty.save(TEST_IO_PATH) ? Matrix::load(TEST_IO_PATH) : NULL;
+  success &= testCheck(loaded && loaded->isEmpty() && _same(empty, *loaded), "io: empty round trip");
+  delete loaded;
+
+  remove(TEST_IO_PATH);
+  success &= testCheck(_rejected(), "io: missing file rejected");
+
+  return success;
+}
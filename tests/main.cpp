@@ -0,0 +1,33 @@
+/*!
+ * \file
+ * \brief Запуск всех проверок (make check); код возврата 1 при любой ошибке
+ */
+#include "tests.h"
+
+#include <stdio.h>
+
+/*!
+ * \brief Напечатать результат случая
+ * \param success Признак успеха
+ * \param what Описание случая
+ * \return success
+ */
+bool testCheck(
+    bool success,
+    const char *what)
+{
+  printf("%s %s\n", success ? "OK  " : "FAIL", what);
+  return success;
+}
+
+int main()
+{
+  bool success = true;
+  success &= testMultiply();
+  success &= testSpan();
+  success &= testIo();
+  success &= testTrack();
+  success &= testSort();
+
+  return success ? 0 : 1;
+}
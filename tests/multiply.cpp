@@ -0,0 +1,111 @@
+/*!
+ * \file
+ * \brief Проверка быстрого умножения: результат Штрассена--Винограда
+ * сравнивается с классическим для обоих способов хранения и прямоугольных
+ * (в том числе нечётных) размеров
+ */
+#include "tests.h"
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+
+/*!
+ * \brief Заполнить матрицу случайными значениями из [-0.5, 0.5]
+ */
+static void _random(
+    Matrix &matrix)
+{
+  for(Matrix::TI i = 0; i < matrix.rowCount(); ++i)
+    for(Matrix::TI j = 0; j < matrix.colCount(); ++j)
+      matrix.o(i, j) = rand() / (real64) RAND_MAX - 0.5;
+}
+
+/*!
+ * \brief Наибольшее расхождение двух матриц одинакового размера
+ */
+static real64 _distance(
+    const Matrix &x,
+    const Matrix &y)
+{
+  real64 result = 0;
+  for(Matrix::TI i = 0; i < x.rowCount(); ++i)
+    for(Matrix::TI j = 0; j < x.colCount(); ++j)
+      result = fmax(result, fabs(x.o(i, j) - y.o(i, j)));
+  return result;
+}
+
+/*!
+ * \brief Сравнить быстрое умножение с классическим
+ * \return Признак успеха
+ */
+static bool _check(
+    Matrix::TI m,
+    Matrix::TI k,
+    Matrix::TI n,
+    bool rowsA,
+    bool rowsB,
+    Matrix::TI cutoff,
+    Matrix::TI maxDepth)
+{
+  Matrix a(m, k, rowsA, 0), b(k, n, rowsB, 0);
+  _random(a);
+  _random(b);
+
+  Matrix *classic = Matrix::multiply(a, b);
+  Matrix *fast = Matrix::multiply(a, b, true, cutoff, maxDepth);
+
+  // Погрешность Штрассена--Винограда растёт с глубиной и длиной сумм
+  const real64 tolerance = 1e-14 * k * (1 << (2 * maxDepth));
+  bool result = classic && fast &&
+      (fast->rowCount() == m) && (fast->colCount() == n);
+  const real64 distance = result ? _distance(*classic, *fast) : INFINITY;
+  result = result && (distance <= tolerance);
+
+  printf("%s %ux%u * %ux%u (%c%c, cutoff %u, depth %u): %.2e\n",
+         result ? "OK  " : "FAIL", m, k, k, n,
+         rowsA ? 'r' : 'c', rowsB ? 'r' : 'c', cutoff, maxDepth, distance);
+
+  delete classic;
+  delete fast;
+  return result;
+}
+
+/*!
+ * \brief Проверить умножение
+ * \return Признак успеха
+ */
+bool testMultiply()
+{
+  srand(1);
+
+  static const Matrix::TI sizes[][3] =
+  {
+    {64, 64, 64},
+    {128, 96, 160},
+    {129, 130, 131},
+    {255, 64, 257},
+    {33, 301, 47},
+    {300, 17, 299},
+    {1, 200, 1}
+  };
+
+  bool success = true;
+  for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    for(int mode = 0; mode < 4; ++mode)
+      success &= _check(sizes[s][0], sizes[s][1], sizes[s][2],
+                        (mode & 1) != 0, (mode & 2) != 0, 8, 4);
+
+  // Размеры крупнее cutoff по умолчанию; maxDepth = 0 -- классический результат
+  success &= _check(1025, 1031, 1027, true, false, 512, 4);
+  success &= _check(100, 100, 100, false, true, 8, 0);
+
+  // Несогласованные размеры
+  Matrix x(3, 4, true, 1), y(3, 4, true, 1);
+  Matrix *z = Matrix::multiply(x, y, true);
+  success &= testCheck(!z, "multiply: size mismatch");
+  delete z;
+
+  return success;
+}
@@ -0,0 +1,172 @@
+/*!
+ * \file
+ * \brief Проверка упорядочивания: sort(), argsort(), topK(), sortRowsBy(),
+ * sortColsBy() дают устойчивый порядок с NaN в конце, в том числе на строках
+ * длиннее порога параллельного слияния
+ */
+#include "tests.h"
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+/*!
+ * \brief Ожидаемый порядок индексов: числа устойчиво по значению, затем NaN
+ * в исходном порядке
+ */
+static std::vector<Matrix::TI> _order(
+    const std::vector<Matrix::TT> &keys,
+    bool descending)
+{
+  std::vector<Matrix::TI> result, nans;
+  for(Matrix::TI i = 0; i < (Matrix::TI) keys.size(); ++i)
+    (std::isnan(keys[i]) ? nans : result).push_back(i);
+
+  std::stable_sort(result.begin(), result.end(), [&](Matrix::TI a, Matrix::TI b)
+  {
+    return descending ? (keys[a] > keys[b]) : (keys[a] < keys[b]);
+  });
+  result.insert(result.end(), nans.begin(), nans.end());
+  return result;
+}
+
+/*!
+ * \brief Случайное значение с повторами и NaN
+ */
+static Matrix::TT _random()
+{
+  return (rand() % 10 == 0) ? NAN : (Matrix::TT) (rand() % 10);
+}
+
+/*!
+ * \brief Проверить sort(), argsort() и topK() вдоль строк или столбцов
+ */
+static bool _lines(
+    Matrix::TI rowCount,
+    Matrix::TI colCount,
+    bool storeRows,
+    bool alongRows,
+    bool descending)
+{
+  Matrix m(rowCount, colCount, storeRows, 0);
+  for(Matrix::TI i = 0; i < rowCount; ++i)
+    for(Matrix::TI j = 0; j < colCount; ++j)
+      m.o(i, j) = _random();
+  const Matrix &c = m;
+
+  const Matrix::TI lines = alongRows ? rowCount : colCount;
+  const Matrix::TI length = alongRows ? colCount : rowCount;
+  const Matrix::TI k = (length > 100) ? 100 : length / 2 + 1;
+
+  Matrix::TI *indices = m.argsort(alongRows, descending);
+  Matrix::TI *top = m.topK(k, alongRows, descending);
+
+  // Ожидаемый порядок -- до сортировки самой матрицы
+  std::vector< std::vector<Matrix::TI> > orders(lines);
+  std::vector< std::vector<Matrix::TT> > keys(lines);
+  for(Matrix::TI l = 0; l < lines; ++l)
+    {
+      for(Matrix::TI i = 0; i < length; ++i)
+        keys[l].push_back(alongRows ? c.o(l, i) : c.o(i, l));
+      orders[l] = _order(keys[l], descending);
+    }
+
+  m.sort(alongRows, descending);
+
+  bool result = indices && top;
+  for(Matrix::TI l = 0; result && (l < lines); ++l)
+    for(Matrix::TI i = 0; result && (i < length); ++i)
+      {
+        const Matrix::TT expected = keys[l][orders[l][i]];
+        const Matrix::TT actual = alongRows ? c.o(l, i) : c.o(i, l);
+        result =
+            (indices[(size_t) l * length + i] == orders[l][i]) &&
+            ((i >= k) || (top[(size_t) l * k + i] == orders[l][i])) &&
+            ((actual == expected) || (std::isnan(actual) && std::isnan(expected)));
+      }
+
+  free(indices);
+  free(top);
+  return result;
+}
+
+/*!
+ * \brief Проверить sortRowsBy() или sortColsBy()
+ */
+static bool _by(
+    bool storeRows,
+    bool byRows,
+    bool descending)
+{
+  // Ключевая строка (столбец) -- 0, метка исходного номера -- 1
+  const Matrix::TI count = 300, other = 4;
+  Matrix m(byRows ? count : other, byRows ? other : count, storeRows, 0);
+  std::vector<Matrix::TT> keys;
+  for(Matrix::TI i = 0; i < count; ++i)
+    {
+      keys.push_back(_random());
+      if(byRows)
+        {
+          m.o(i, 0) = keys.back();
+          for(Matrix::TI j = 1; j < other; ++j) m.o(i, j) = i;
+        }
+      else
+        {
+          m.o(0, i) = keys.back();
+          for(Matrix::TI j = 1; j < other; ++j) m.o(j, i) = i;
+        }
+    }
+  const std::vector<Matrix::TI> order = _order(keys, descending);
+
+  if(byRows) m.sortRowsBy(0, descending);
+  else m.sortColsBy(0, descending);
+
+  const Matrix &c = m;
+  bool result = true;
+  for(Matrix::TI i = 0; result && (i < count); ++i)
+    for(Matrix::TI j = 1; j < other; ++j)
+      result = result && ((byRows ? c.o(i, j) : c.o(j, i)) == order[i]);
+  return result;
+}
+
+/*!
+ * \brief Проверить упорядочивание
+ * \return Признак успеха
+ */
+bool testSort()
+{
+  bool success = true;
+  char what[128];
+  srand(4);
+
+  for(int store = 0; store < 2; ++store)
+    for(int descending = 0; descending < 2; ++descending)
+      {
+        const char *mode = (store == 0) ? "rows" : "cols";
+        const char *direction = descending ? "desc" : "asc";
+
+        snprintf(what, sizeof(what), "sort (%s, %s): short lines", mode, direction);
+        success &= testCheck(
+              _lines(50, 37, store == 0, true, descending != 0) &&
+              _lines(50, 37, store == 0, false, descending != 0),
+              what);
+
+        // Строки длиннее MATRIX_SORT_PARALLEL_MIN -- параллельное слияние
+        snprintf(what, sizeof(what), "sort (%s, %s): long lines", mode, direction);
+        success &= testCheck(
+              _lines(3, 70000, store == 0, true, descending != 0) &&
+              _lines(70000, 2, store == 0, false, descending != 0),
+              what);
+
+        snprintf(what, sizeof(what), "sort (%s, %s): sortRowsBy/sortColsBy", mode, direction);
+        success &= testCheck(
+              _by(store == 0, true, descending != 0) &&
+              _by(store == 0, false, descending != 0),
+              what);
+      }
+
+  return success;
+}
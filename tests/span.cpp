@@ -0,0 +1,176 @@
+/*!
+ * \file
+ * \brief Проверка доступа к строкам и столбцам: rows(), cols(), setRow(),
+ * setCol(), insertRows(), insertCols() при обоих способах хранения
+ */
+#include "tests.h"
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <utility>
+
+/*!
+ * \brief Значение элемента (i, j) проверочной матрицы
+ */
+static Matrix::TT _value(
+    Matrix::TI i,
+    Matrix::TI j)
+{
+  return i * 1000.0 + j;
+}
+
+/*!
+ * \brief Элемент без отметки об изменении (константный o())
+ */
+static Matrix::TT _at(
+    const Matrix &matrix,
+    Matrix::TI i,
+    Matrix::TI j)
+{
+  return matrix.o(i, j);
+}
+
+/*!
+ * \brief Создать проверочную матрицу
+ */
+static Matrix *_matrix(
+    Matrix::TI rowCount,
+    Matrix::TI colCount,
+    bool storeRows)
+{
+  Matrix *result = new Matrix(rowCount, colCount, storeRows, -1);
+  for(Matrix::TI i = 0; i < rowCount; ++i)
+    for(Matrix::TI j = 0; j < colCount; ++j)
+      result->o(i, j) = _value(i, j);
+  return result;
+}
+
+/*!
+ * \brief Проверить блок строк (столбцов) поэлементно
+ */
+static bool _span(
+    const Matrix &matrix,
+    Matrix::TI begin,
+    Matrix::TI count,
+    bool byRows)
+{
+  const Matrix::Span span = byRows ? matrix.rows(begin, count) : matrix.cols(begin, count);
+  const Matrix::TI other = byRows ? matrix.colCount() : matrix.rowCount();
+
+  // Без копирования -- только если блок непрерывен в памяти
+  bool result =
+      (span.count() == (size_t) count * other) &&
+      (span.isCopy() != (byRows == matrix.storeMode()));
+  for(Matrix::TI k = 0; result && (k < count); ++k)
+    for(Matrix::TI m = 0; m < other; ++m)
+      {
+        const Matrix::TI i = byRows ? begin + k : m, j = byRows ? m : begin + k;
+        result = result && (span[(size_t) k * other + m] == matrix.o(i, j));
+      }
+  return result;
+}
+
+/*!
+ * \brief Проверить строки и столбцы
+ * \return Признак успеха
+ */
+bool testSpan()
+{
+  bool success = true;
+  char what[128];
+
+  for(int mode = 0; mode < 2; ++mode)
+    {
+      const bool storeRows = (mode == 0);
+      const char *name = storeRows ? "rows" : "cols";
+
+      // Чтение
+      Matrix *m = _matrix(37, 23, storeRows);
+      snprintf(what, sizeof(what), "span (%s): rows/cols/row/col", name);
+      success &= testCheck(
+            _span(*m, 0, 37, true) && _span(*m, 5, 3, true) && _span(*m, 36, 1, true) &&
+            _span(*m, 0, 23, false) && _span(*m, 7, 4, false) && _span(*m, 22, 1, false) &&
+            (m->row(3).count() == 23) && (m->row(3)[4] == _value(3, 4)) &&
+            (m->col(4).count() == 37) && (m->col(4)[3] == _value(3, 4)),
+            what);
+
+      snprintf(what, sizeof(what), "span (%s): out of range", name);
+      success &= testCheck(
+            m->rows(37, 1).isEmpty() && m->rows(30, 8).isEmpty() &&
+            m->cols(0, 0).isEmpty() && m->cols(23, 1).isEmpty(),
+            what);
+
+      // Перемещение владеющего блока
+      Matrix::Span moved = storeRows ? m->cols(2, 2) : m->rows(2, 2);
+      Matrix::Span target;
+      target = std::move(moved);
+      snprintf(what, sizeof(what), "span (%s): move", name);
+      success &= testCheck(
+            moved.isEmpty() && target.isCopy() && (target.count() == (storeRows ? 74u : 46u)) &&
+            (target[1] == (storeRows ? _value(1, 2) : _value(2, 1))),
+            what);
+
+      // Запись
+      Matrix::TT row[23], col[37];
+      for(Matrix::TI j = 0; j < 23; ++j) row[j] = -(Matrix::TT) j;
+      for(Matrix::TI i = 0; i < 37; ++i) col[i] = -1000.0 * i;
+      m->setRow(4, row);
+      m->setCol(6, col);
+      snprintf(what, sizeof(what), "span (%s): setRow/setCol", name);
+      success &= testCheck(
+            (_at(*m, 4, 5) == -5) && (_at(*m, 4, 6) == -4000) && (_at(*m, 10, 6) == -10000) &&
+            (_at(*m, 3, 5) == _value(3, 5)) && (_at(*m, 5, 7) == _value(5, 7)),
+            what);
+      delete m;
+
+      // Вставка строк: значения и значение по умолчанию
+      m = _matrix(10, 6, storeRows);
+      Matrix::TT rows[2 * 6];
+      for(int k = 0; k < 2 * 6; ++k) rows[k] = 0.5 + k;
+      m->insertRows(3, 2, rows);
+      m->insertRows(12, 1);
+      m->insertRows(0, 1);
+      bool inserted = (m->rowCount() == 14) && (m->colCount() == 6);
+      for(Matrix::TI i = 0; inserted && (i < 14); ++i)
+        for(Matrix::TI j = 0; j < 6; ++j)
+          {
+            const Matrix::TT expected =
+                (i == 0) || (i == 13) ? -1 :
+                (i == 4) || (i == 5) ? 0.5 + (i - 4) * 6 + j :
+                _value((i < 4) ? i - 1 : i - 3, j);
+            inserted = inserted && (_at(*m, i, j) == expected);
+          }
+      snprintf(what, sizeof(what), "span (%s): insertRows", name);
+      success &= testCheck(inserted, what);
+      delete m;
+
+      // Вставка столбцов
+      m = _matrix(6, 10, storeRows);
+      Matrix::TT cols[2 * 6];
+      for(int k = 0; k < 2 * 6; ++k) cols[k] = 0.5 + k;
+      m->insertCols(10, 2, cols);
+      m->insertCols(2, 1);
+      inserted = (m->rowCount() == 6) && (m->colCount() == 13);
+      for(Matrix::TI i = 0; inserted && (i < 6); ++i)
+        for(Matrix::TI j = 0; j < 13; ++j)
+          {
+            const Matrix::TT expected =
+                (j == 2) ? -1 :
+                (j >= 11) ? 0.5 + (j - 11) * 6 + i :
+                _value(i, (j < 2) ? j : j - 1);
+            inserted = inserted && (_at(*m, i, j) == expected);
+          }
+      snprintf(what, sizeof(what), "span (%s): insertCols", name);
+      success &= testCheck(inserted, what);
+
+      // Некорректная вставка ничего не меняет
+      m->insertCols(14, 1);
+      m->insertRows(0, 0);
+      snprintf(what, sizeof(what), "span (%s): insert out of range", name);
+      success &= testCheck((m->rowCount() == 6) && (m->colCount() == 13), what);
+      delete m;
+    }
+
+  return success;
+}
@@ -0,0 +1,17 @@
+/*!
+ * \file
+ * \brief Проверки библиотеки
+ *
+ * Каждая проверка печатает по строке на случай и возвращает признак успеха.
+ */
+#pragma once
+
+bool testCheck(
+    bool success,
+    const char *what);
+
+bool testMultiply();
+bool testSpan();
+bool testIo();
+bool testTrack();
+bool testSort();
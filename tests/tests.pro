@@ -0,0 +1,20 @@
+# Проверки библиотеки (make check)
+TEMPLATE = app
+TARGET = matrix_tests
+
+OBJECTS_DIR = obj
+CONFIG += console c++11 testcase
+CONFIG -= qt app_bundle
+
+include(../matrix.pri)
+
+HEADERS += \
+    tests.h
+
+SOURCES += \
+    main.cpp \
+    multiply.cpp \
+    span.cpp \
+    io.cpp \
+    track.cpp \
+    sort.cpp
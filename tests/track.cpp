@@ -0,0 +1,129 @@
+/*!
+ * \file
+ * \brief Проверка кэшируемых свёрток: rowSums(), rowNorms(), colSums(),
+ * colNorms() совпадают с прямым вычислением после любых изменений при каждом
+ * способе отслеживания
+ */
+#include "tests.h"
+#include "matrix.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+
+/*!
+ * \brief Совпадают ли кэшированные свёртки с прямым вычислением
+ */
+static bool _reductions(
+    Matrix &matrix)
+{
+  const Matrix &m = matrix;
+  const Matrix::TT
+      *rowSums = matrix.rowSums(), *rowNorms = matrix.rowNorms(),
+      *colSums = matrix.colSums(), *colNorms = matrix.colNorms();
+
+  bool result = true;
+  for(Matrix::TI i = 0; i < m.rowCount(); ++i)
+    {
+      Matrix::TT sum = 0, squares = 0;
+      for(Matrix::TI j = 0; j < m.colCount(); ++j)
+        {
+          sum += m.o(i, j);
+          squares += m.o(i, j) * m.o(i, j);
+        }
+      result = result &&
+          (fabs(rowSums[i] - sum) <= 1e-9 * (1 + fabs(sum))) &&
+          (fabs(rowNorms[i] - sqrt(squares)) <= 1e-9 * (1 + sqrt(squares)));
+    }
+  for(Matrix::TI j = 0; j < m.colCount(); ++j)
+    {
+      Matrix::TT sum = 0, squares = 0;
+      for(Matrix::TI i = 0; i < m.rowCount(); ++i)
+        {
+          sum += m.o(i, j);
+          squares += m.o(i, j) * m.o(i, j);
+        }
+      result = result &&
+          (fabs(colSums[j] - sum) <= 1e-9 * (1 + fabs(sum))) &&
+          (fabs(colNorms[j] - sqrt(squares)) <= 1e-9 * (1 + sqrt(squares)));
+    }
+  return result;
+}
+
+/*!
+ * \brief Проверить свёртки
+ * \return Признак успеха
+ */
+bool testTrack()
+{
+  static const Matrix::DirtyMode modes[] =
+  {
+    Matrix::DirtyOff,
+    Matrix::DirtyRows,
+    Matrix::DirtyCols,
+    Matrix::DirtyTiles
+  };
+  static const char *names[] = {"off", "rows", "cols", "tiles"};
+
+  bool success = true;
+  char what[128];
+  srand(2);
+
+  for(int store = 0; store < 2; ++store)
+    for(int k = 0; k < 4; ++k)
+      {
+        // Размеры не кратны ни блокам отслеживания, ни полосам свёрток
+        Matrix m(300, 170, store == 0, 0.5);
+        m.setDirtyTracking(modes[k], 7, 13);
+        bool valid = _reductions(m);
+
+        Matrix::TT values[300];
+        for(int step = 0; valid && (step < 120); ++step)
+          {
+            switch(step % 6)
+              {
+              case 0:
+                m.o(rand() % m.rowCount(), rand() % m.colCount()) = rand() % 100;
+                break;
+              case 1:
+                for(Matrix::TI j = 0; j < m.colCount(); ++j) values[j] = rand() % 7;
+                m.setRow(rand() % m.rowCount(), values);
+                break;
+              case 2:
+                for(Matrix::TI i = 0; i < m.rowCount(); ++i) values[i] = -(rand() % 5);
+                m.setCol(rand() % m.colCount(), values);
+                break;
+              case 3:
+                if(m.rowCount() > 100) m.deleteRow(rand() % 50, 2);
+                break;
+              case 4:
+                m.sortRowsBy(rand() % m.colCount(), (step % 4) == 0);
+                break;
+              default:
+                if(step % 30 == 5) m.fill(1);
+                else if(step % 30 == 11) m.sort(false);
+                else m.o(0, 0) += 1;
+                break;
+              }
+
+            // Иногда -- несколько изменений между вызовами свёрток
+            if(rand() % 3) valid = _reductions(m);
+          }
+        valid = valid && _reductions(m);
+
+        snprintf(what, sizeof(what), "track (%s, %s): reductions after changes",
+                 (store == 0) ? "rows" : "cols", names[k]);
+        success &= testCheck(valid, what);
+      }
+
+  // isDirty: изменённый блок и нетронутый
+  Matrix m(100, 100, true, 0);
+  m.setDirtyTracking(Matrix::DirtyTiles, 10, 10);
+  const uint64 mark = m.checkpoint();
+  m.o(15, 25) = 1;
+  success &= testCheck(
+        m.isDirty(19, 29, mark) && !m.isDirty(15, 35, mark) && !m.isDirty(5, 25, mark),
+        "track: isDirty");
+
+  return success;
+}